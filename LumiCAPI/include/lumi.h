@@ -0,0 +1,139 @@
+#ifndef LUMI_H
+#define LUMI_H
+
+/*
+ * C interface to the LumiTracer renderer.
+ *
+ * Scenes and renderers are opaque handles. Every renderer is independent, so a process may create as many
+ * as it likes and drive them from different threads. A scene may be rendered by several renderers at once
+ * as long as nothing modifies it meanwhile.
+ *
+ * Images are width * height pixels, stored bottom row first.
+ */
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+    #if defined(LUMI_BUILD_DLL)
+        #define LUMI_API __declspec(dllexport)
+    #else
+        #define LUMI_API __declspec(dllimport)
+    #endif
+#else
+    #define LUMI_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped whenever a function signature or struct layout changes. */
+#define LUMI_API_VERSION 2
+
+typedef struct LumiScene LumiScene;
+typedef struct LumiRenderer LumiRenderer;
+
+typedef enum LumiResult {
+    LUMI_OK = 0,
+    LUMI_ERROR_INVALID_ARGUMENT = 1,
+    LUMI_ERROR_OUT_OF_MEMORY = 2
+} LumiResult;
+
+typedef struct LumiMaterial {
+    float albedo[3];
+    float roughness;
+    float metallic;
+    float emissive_color[3];
+    float emissive_strength;
+
+    /* Indices returned by lumi_scene_add_texture, which start at 1. 0 leaves the channel untextured, so a
+     * zero-initialized material has no maps. */
+    int32_t albedo_texture;
+    int32_t roughness_texture;
+    int32_t metallic_texture;
+    int32_t emissive_texture;
+} LumiMaterial;
+
+typedef struct LumiSphere {
+    float position[3];
+    float radius;
+    int32_t material_index;
+} LumiSphere;
+
+LUMI_API uint32_t lumi_get_api_version(void);
+
+/* Scenes */
+
+LUMI_API LumiScene* lumi_scene_create(void);
+LUMI_API void lumi_scene_destroy(LumiScene* scene);
+
+/* Removes all spheres, materials and textures. */
+LUMI_API void lumi_scene_clear(LumiScene* scene);
+
+/* Copies `count` entries from the caller's array. The index of the first new entry is written to
+ * `first_index` if it isn't NULL. Spheres may refer to materials that are added later, as long as they
+ * exist by the time the scene is rendered. */
+LUMI_API LumiResult lumi_scene_add_materials(LumiScene* scene, const LumiMaterial* materials, uint32_t count, uint32_t* first_index);
+LUMI_API LumiResult lumi_scene_add_spheres(LumiScene* scene, const LumiSphere* spheres, uint32_t count, uint32_t* first_index);
+
+/* Registers an image file for use as a material map and returns its index, starting at 1. Files are
+ * opened lazily on first render. */
+LUMI_API LumiResult lumi_scene_add_texture(LumiScene* scene, const char* path, uint32_t* index);
+
+LUMI_API uint32_t lumi_scene_get_sphere_count(const LumiScene* scene);
+LUMI_API uint32_t lumi_scene_get_material_count(const LumiScene* scene);
+
+/* Renderers */
+
+LUMI_API LumiRenderer* lumi_renderer_create(void);
+LUMI_API void lumi_renderer_destroy(LumiRenderer* renderer);
+
+/* Sets the view and the output resolution, which may not exceed 2^32 - 1 pixels. Restarts accumulation. */
+LUMI_API LumiResult lumi_renderer_set_camera(LumiRenderer* renderer, const float position[3], const float direction[3], float vertical_fov, uint32_t width, uint32_t height);
+
+/* Directory for the tiled copies of textures, which otherwise go next to each image as <path>.luxtex. Set it
+ * when images live somewhere read-only. NULL or "" restores the default. */
+LUMI_API LumiResult lumi_renderer_set_texture_cache_directory(LumiRenderer* renderer, const char* directory);
+
+LUMI_API void lumi_renderer_set_max_bounces(LumiRenderer* renderer, int32_t bounces);
+
+/* Next event estimation through a light hierarchy, enabled by default. */
+LUMI_API void lumi_renderer_set_light_sampling(LumiRenderer* renderer, int32_t enabled);
+
+/* Limits tracing to pixels in [min, max), row 0 at the bottom. Restarts accumulation. */
+LUMI_API void lumi_renderer_set_crop_window(LumiRenderer* renderer, uint32_t min_x, uint32_t min_y, uint32_t max_x, uint32_t max_y);
+LUMI_API void lumi_renderer_clear_crop_window(LumiRenderer* renderer);
+
+/* Discards accumulated samples, call after editing a scene that is being rendered. */
+LUMI_API void lumi_renderer_reset(LumiRenderer* renderer);
+
+/* Adds `samples` samples per pixel to the accumulation buffer and refreshes the RGBA image. Fails with
+ * LUMI_ERROR_INVALID_ARGUMENT if a sphere refers to a missing material, a material to a missing texture,
+ * or caller-supplied buffers don't match the camera's resolution. */
+LUMI_API LumiResult lumi_renderer_render(LumiRenderer* renderer, const LumiScene* scene, uint32_t samples);
+
+/* Samples per pixel accumulated since the last reset. */
+LUMI_API uint32_t lumi_renderer_get_sample_count(const LumiRenderer* renderer);
+
+/*
+ * Direct views of the renderer's buffers, NULL before the first render. The accumulation buffer holds four
+ * floats per pixel (RGBA) summed over lumi_renderer_get_sample_count() samples. The image holds one packed
+ * RGBA8 value per pixel, red in the lowest byte, already averaged and clamped. Both stay valid until the
+ * next call that changes the resolution or the buffers.
+ */
+LUMI_API const float* lumi_renderer_get_accumulation(const LumiRenderer* renderer);
+LUMI_API const uint32_t* lumi_renderer_get_image(const LumiRenderer* renderer);
+
+/*
+ * Makes the renderer write straight into caller-owned memory. `accumulation` must hold width * height * 4
+ * floats and `image` width * height values, and both must outlive their use. Rendering only proceeds while
+ * the camera's resolution is width x height. Pass NULL for both to go back to buffers owned by the
+ * renderer. Restarts accumulation.
+ */
+LUMI_API LumiResult lumi_renderer_set_buffers(LumiRenderer* renderer, float* accumulation, uint32_t* image, uint32_t width, uint32_t height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
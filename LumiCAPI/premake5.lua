@@ -0,0 +1,67 @@
+project "LumiCAPI"
+   kind "SharedLib"
+   language "C++"
+   cppdialect "C++20"
+   staticruntime "off"
+   targetname "lumi"
+   pic "On"
+
+   files
+   {
+      "include/**.h",
+      "src/**.h",
+      "src/**.cpp",
+
+      -- Renderer core, built without Walnut
+      "../LumiTracer/src/BVH.h",
+      "../LumiTracer/src/Camera.h",
+      "../LumiTracer/src/Camera.cpp",
+      "../LumiTracer/src/CounterIterator.h",
+      "../LumiTracer/src/Geometry.h",
+      "../LumiTracer/src/Geometry.cpp",
+      "../LumiTracer/src/LightTree.h",
+      "../LumiTracer/src/LightTree.cpp",
+      "../LumiTracer/src/Ray.h",
+      "../LumiTracer/src/Renderer.h",
+      "../LumiTracer/src/Renderer.cpp",
+      "../LumiTracer/src/RowPool.h",
+      "../LumiTracer/src/RowPool.cpp",
+      "../LumiTracer/src/Scene.h",
+      "../LumiTracer/src/Texture.h",
+      "../LumiTracer/src/Texture.cpp",
+   }
+
+   includedirs
+   {
+      "include",
+
+      "../Walnut/vendor/glm",
+      "../Walnut/vendor/stb_image",
+
+      "../LumiTracer/src",
+   }
+
+   defines { "LUX_HEADLESS", "LUMI_BUILD_DLL" }
+
+   -- Only the lumi_* entry points are exported
+   visibility "Hidden"
+
+   targetdir ("../bin/" .. outputdir .. "/bin/%{prj.name}")
+   objdir ("../bin/" .. outputdir .. "/int/%{prj.name}")
+
+   filter "system:linux"
+      links { "pthread", "tbb" }
+
+   filter "configurations:Debug"
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   filter "configurations:Dist"
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
@@ -0,0 +1,345 @@
+#include "lumi.h"
+
+#include "Camera.h"
+#include "LightTree.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "Texture.h"
+
+#include <cstdint>
+#include <limits>
+#include <new>
+
+// The buffer accessors hand out glm storage as plain floats
+static_assert(sizeof(glm::vec4) == 4 * sizeof(float), "glm::vec4 must be tightly packed");
+static_assert(sizeof(glm::u32) == sizeof(uint32_t));
+
+struct LumiScene {
+	Scene scene;
+	LightTree lights;
+};
+
+struct LumiRenderer {
+	Renderer renderer;
+	TextureCache textures;
+	Camera camera{ 45.0f, 0.1f, 100.0f };
+
+	// Size of caller-supplied buffers, zero while the renderer owns them
+	glm::u32vec2 bufferSize{ 0, 0 };
+};
+
+namespace {
+	static constexpr std::uint64_t MaxPixels = std::numeric_limits<glm::u32>::max();
+
+	static glm::vec3 toVec3(const float* values) {
+		return { values[0], values[1], values[2] };
+	}
+
+	// The C API counts textures from 1 so that 0 means none
+	static int toTextureIndex(const int32_t index) {
+		return index > 0 ? index - 1 : -1;
+	}
+
+	static bool validTexture(const int index, const Scene& scene) {
+		return index < static_cast<int>(scene.textures.size());
+	}
+
+	// Everything Renderer indexes without checking
+	static bool validScene(const Scene& scene) {
+		for (const Material& material : scene.materials) {
+			if (!validTexture(material.albedoTexture, scene) || !validTexture(material.roughnessTexture, scene)
+				|| !validTexture(material.metallicTexture, scene) || !validTexture(material.emissiveTexture, scene)) {
+				return false;
+			}
+		}
+
+		for (const Sphere& sphere : scene.spheres) {
+			if (sphere.materialIndex < 0 || sphere.materialIndex >= static_cast<int>(scene.materials.size())) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+extern "C" {
+
+uint32_t lumi_get_api_version(void) {
+	return LUMI_API_VERSION;
+}
+
+LumiScene* lumi_scene_create(void) {
+	return new (std::nothrow) LumiScene();
+}
+
+void lumi_scene_destroy(LumiScene* scene) {
+	delete scene;
+}
+
+void lumi_scene_clear(LumiScene* scene) {
+	if (!scene) {
+		return;
+	}
+
+	scene->scene = {};
+	scene->lights.Update(scene->scene);
+}
+
+LumiResult lumi_scene_add_materials(LumiScene* scene, const LumiMaterial* materials, uint32_t count, uint32_t* first_index) {
+	if (!scene || (!materials && count > 0)) {
+		return LUMI_ERROR_INVALID_ARGUMENT;
+	}
+
+	try {
+		std::vector<Material>& target = scene->scene.materials;
+		const std::size_t first = target.size();
+		target.reserve(first + count);
+
+		for (uint32_t i = 0; i < count; i++) {
+			const LumiMaterial& material = materials[i];
+
+			target.push_back({
+				.albedo = toVec3(material.albedo),
+				.roughness = material.roughness,
+				.metallic = material.metallic,
+				.emissiveColor = toVec3(material.emissive_color),
+				.emissiveStrength = material.emissive_strength,
+				.albedoTexture = toTextureIndex(material.albedo_texture),
+				.roughnessTexture = toTextureIndex(material.roughness_texture),
+				.metallicTexture = toTextureIndex(material.metallic_texture),
+				.emissiveTexture = toTextureIndex(material.emissive_texture)
+			});
+		}
+
+		// Existing spheres may refer to materials that only now exist
+		scene->lights.Update(scene->scene);
+
+		if (first_index) {
+			*first_index = static_cast<uint32_t>(first);
+		}
+	} catch (const std::bad_alloc&) {
+		return LUMI_ERROR_OUT_OF_MEMORY;
+	}
+
+	return LUMI_OK;
+}
+
+LumiResult lumi_scene_add_spheres(LumiScene* scene, const LumiSphere* spheres, uint32_t count, uint32_t* first_index) {
+	if (!scene || (!spheres && count > 0)) {
+		return LUMI_ERROR_INVALID_ARGUMENT;
+	}
+
+	try {
+		std::vector<Sphere>& target = scene->scene.spheres;
+		const std::size_t first = target.size();
+		target.reserve(first + count);
+
+		for (uint32_t i = 0; i < count; i++) {
+			const LumiSphere& sphere = spheres[i];
+
+			target.push_back({
+				.position = toVec3(sphere.position),
+				.radius = sphere.radius,
+				.materialIndex = sphere.material_index
+			});
+		}
+
+		scene->lights.Update(scene->scene);
+
+		if (first_index) {
+			*first_index = static_cast<uint32_t>(first);
+		}
+	} catch (const std::bad_alloc&) {
+		return LUMI_ERROR_OUT_OF_MEMORY;
+	}
+
+	return LUMI_OK;
+}
+
+LumiResult lumi_scene_add_texture(LumiScene* scene, const char* path, uint32_t* index) {
+	if (!scene || !path) {
+		return LUMI_ERROR_INVALID_ARGUMENT;
+	}
+
+	try {
+		scene->scene.textures.emplace_back(path);
+	} catch (const std::bad_alloc&) {
+		return LUMI_ERROR_OUT_OF_MEMORY;
+	}
+
+	if (index) {
+		*index = static_cast<uint32_t>(scene->scene.textures.size());
+	}
+
+	return LUMI_OK;
+}
+
+uint32_t lumi_scene_get_sphere_count(const LumiScene* scene) {
+	return scene ? static_cast<uint32_t>(scene->scene.spheres.size()) : 0;
+}
+
+uint32_t lumi_scene_get_material_count(const LumiScene* scene) {
+	return scene ? static_cast<uint32_t>(scene->scene.materials.size()) : 0;
+}
+
+LumiRenderer* lumi_renderer_create(void) {
+	LumiRenderer* renderer = new (std::nothrow) LumiRenderer();
+	if (!renderer) {
+		return nullptr;
+	}
+
+	renderer->renderer.SetTextureCache(&renderer->textures);
+	renderer->renderer.GetFlags() |= Renderer::Flags::Accumulate;
+	renderer->renderer.GetFlags() |= Renderer::Flags::LightSampling;
+
+	return renderer;
+}
+
+void lumi_renderer_destroy(LumiRenderer* renderer) {
+	delete renderer;
+}
+
+LumiResult lumi_renderer_set_camera(LumiRenderer* renderer, const float position[3], const float direction[3], float vertical_fov, uint32_t width, uint32_t height) {
+	if (!renderer || !position || !direction || !(vertical_fov > 0.0f && vertical_fov < 180.0f)) {
+		return LUMI_ERROR_INVALID_ARGUMENT;
+	}
+
+	const glm::vec3 forward = toVec3(direction);
+	if (glm::dot(forward, forward) == 0.0f) {
+		return LUMI_ERROR_INVALID_ARGUMENT;
+	}
+
+	// Pixels are addressed with 32-bit indices, and a larger image wouldn't fit in memory anyway
+	if (static_cast<std::uint64_t>(width) * height > MaxPixels) {
+		return LUMI_ERROR_INVALID_ARGUMENT;
+	}
+
+	try {
+		// The field of view is fixed at construction
+		if (vertical_fov != renderer->camera.GetVerticalFOV()) {
+			renderer->camera = Camera(vertical_fov, 0.1f, 100.0f);
+		}
+
+		renderer->camera.Resize(width, height);
+		renderer->camera.SetView(toVec3(position), forward);
+	} catch (const std::bad_alloc&) {
+		return LUMI_ERROR_OUT_OF_MEMORY;
+	}
+
+	renderer->renderer.ResetAccumulationFrames();
+
+	return LUMI_OK;
+}
+
+LumiResult lumi_renderer_set_texture_cache_directory(LumiRenderer* renderer, const char* directory) {
+	if (!renderer) {
+		return LUMI_ERROR_INVALID_ARGUMENT;
+	}
+
+	try {
+		renderer->textures.SetCacheDirectory(directory ? directory : "");
+	} catch (const std::bad_alloc&) {
+		return LUMI_ERROR_OUT_OF_MEMORY;
+	}
+
+	return LUMI_OK;
+}
+
+void lumi_renderer_set_max_bounces(LumiRenderer* renderer, int32_t bounces) {
+	if (!renderer) {
+		return;
+	}
+
+	renderer->renderer.SetMaxBounces(bounces);
+	renderer->renderer.ResetAccumulationFrames();
+}
+
+void lumi_renderer_set_light_sampling(LumiRenderer* renderer, int32_t enabled) {
+	if (!renderer) {
+		return;
+	}
+
+	if (enabled) {
+		renderer->renderer.GetFlags() |= Renderer::Flags::LightSampling;
+	} else {
+		renderer->renderer.GetFlags() &= ~Renderer::Flags::LightSampling;
+	}
+
+	renderer->renderer.ResetAccumulationFrames();
+}
+
+void lumi_renderer_set_crop_window(LumiRenderer* renderer, uint32_t min_x, uint32_t min_y, uint32_t max_x, uint32_t max_y) {
+	if (renderer) {
+		renderer->renderer.SetCropWindow({ min_x, min_y }, { max_x, max_y });
+	}
+}
+
+void lumi_renderer_clear_crop_window(LumiRenderer* renderer) {
+	if (renderer) {
+		renderer->renderer.ClearCropWindow();
+	}
+}
+
+void lumi_renderer_reset(LumiRenderer* renderer) {
+	if (renderer) {
+		renderer->renderer.ResetAccumulationFrames();
+	}
+}
+
+LumiResult lumi_renderer_render(LumiRenderer* renderer, const LumiScene* scene, uint32_t samples) {
+	if (!renderer || !scene) {
+		return LUMI_ERROR_INVALID_ARGUMENT;
+	}
+
+	const glm::u32vec2 viewport = renderer->camera.GetViewport();
+	if (viewport.x == 0 || viewport.y == 0) {
+		return LUMI_ERROR_INVALID_ARGUMENT;
+	}
+
+	if (renderer->bufferSize != glm::u32vec2(0, 0) && renderer->bufferSize != viewport) {
+		return LUMI_ERROR_INVALID_ARGUMENT;
+	}
+
+	if (!validScene(scene->scene)) {
+		return LUMI_ERROR_INVALID_ARGUMENT;
+	}
+
+	renderer->renderer.SetLightTree(&scene->lights);
+
+	try {
+		for (uint32_t i = 0; i < samples; i++) {
+			renderer->renderer.Render(scene->scene, renderer->camera);
+		}
+	} catch (const std::bad_alloc&) {
+		return LUMI_ERROR_OUT_OF_MEMORY;
+	}
+
+	return LUMI_OK;
+}
+
+uint32_t lumi_renderer_get_sample_count(const LumiRenderer* renderer) {
+	return renderer ? renderer->renderer.GetAccumulationFrames() - 1 : 0;
+}
+
+const float* lumi_renderer_get_accumulation(const LumiRenderer* renderer) {
+	return renderer ? reinterpret_cast<const float*>(renderer->renderer.GetAccumulationData()) : nullptr;
+}
+
+const uint32_t* lumi_renderer_get_image(const LumiRenderer* renderer) {
+	return renderer ? renderer->renderer.GetFinalImageData() : nullptr;
+}
+
+LumiResult lumi_renderer_set_buffers(LumiRenderer* renderer, float* accumulation, uint32_t* image, uint32_t width, uint32_t height) {
+	if (!renderer || (!accumulation != !image) || (accumulation && (width == 0 || height == 0))
+		|| static_cast<std::uint64_t>(width) * height > MaxPixels) {
+		return LUMI_ERROR_INVALID_ARGUMENT;
+	}
+
+	renderer->bufferSize = accumulation ? glm::u32vec2(width, height) : glm::u32vec2(0, 0);
+	renderer->renderer.SetOutputBuffers(reinterpret_cast<glm::vec4*>(accumulation), image, renderer->bufferSize);
+
+	return LUMI_OK;
+}
+
+}
@@ -0,0 +1,24 @@
+project "LumiClient"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++20"
+   staticruntime "off"
+
+   files { "src/**.h", "src/**.cpp" }
+
+   targetdir ("../bin/" .. outputdir .. "/bin/%{prj.name}")
+   objdir ("../bin/" .. outputdir .. "/int/%{prj.name}")
+
+   filter "configurations:Debug"
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   filter "configurations:Dist"
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
@@ -0,0 +1,79 @@
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Sends one command to lumiserver and prints every reply line, e.g.
+//   lumiclient render scene=scenes/default.lux out=preview.ppm width=320 height=180 spp=16
+int main(int argc, char** argv) {
+	std::string socketPath = "/tmp/lumitracer.sock";
+
+	int first = 1;
+	if (argc > 2 && std::strcmp(argv[1], "--socket") == 0) {
+		socketPath = argv[2];
+		first = 3;
+	}
+
+	if (first >= argc) {
+		std::cerr << "usage: " << argv[0] << " [--socket path] <render ...|status|shutdown>" << std::endl;
+		return 1;
+	}
+
+	std::string command;
+	for (int i = first; i < argc; i++) {
+		std::string argument = argv[i];
+
+		// The server wants absolute paths, relative ones are meant relative to where the client runs
+		for (const char* key : { "scene=", "out=" }) {
+			const std::size_t length = std::strlen(key);
+			if (argument.compare(0, length, key) == 0 && argument.size() > length) {
+				argument = key + std::filesystem::absolute(argument.substr(length)).lexically_normal().string();
+			}
+		}
+
+		command += (i == first ? "" : " ") + argument;
+	}
+	command += "\n";
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(address.sun_path)) {
+		std::cerr << "socket path too long" << std::endl;
+		return 1;
+	}
+	socketPath.copy(address.sun_path, socketPath.size());
+
+	const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server < 0 || connect(server, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+		std::cerr << "cannot connect to " << socketPath << std::endl;
+		return 1;
+	}
+
+	send(server, command.data(), command.size(), 0);
+
+	// The server closes the connection after its final reply
+	bool failed = false;
+	std::string line;
+	char buffer[256];
+	ssize_t received;
+	while ((received = recv(server, buffer, sizeof(buffer), 0)) > 0) {
+		for (ssize_t i = 0; i < received; i++) {
+			if (buffer[i] != '\n') {
+				line += buffer[i];
+				continue;
+			}
+
+			std::cout << line << std::endl;
+			failed |= line.rfind("error", 0) == 0;
+			line.clear();
+		}
+	}
+
+	close(server);
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,60 @@
+project "LumiServer"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++20"
+   staticruntime "off"
+
+   files
+   {
+      "src/**.h",
+      "src/**.cpp",
+
+      -- Renderer core, built without Walnut
+      "../LumiTracer/src/BVH.h",
+      "../LumiTracer/src/Camera.h",
+      "../LumiTracer/src/Camera.cpp",
+      "../LumiTracer/src/CounterIterator.h",
+      "../LumiTracer/src/Geometry.h",
+      "../LumiTracer/src/Geometry.cpp",
+      "../LumiTracer/src/LightTree.h",
+      "../LumiTracer/src/LightTree.cpp",
+      "../LumiTracer/src/Ray.h",
+      "../LumiTracer/src/Renderer.h",
+      "../LumiTracer/src/Renderer.cpp",
+      "../LumiTracer/src/RowPool.h",
+      "../LumiTracer/src/RowPool.cpp",
+      "../LumiTracer/src/Scene.h",
+      "../LumiTracer/src/SceneFile.h",
+      "../LumiTracer/src/SceneFile.cpp",
+      "../LumiTracer/src/Texture.h",
+      "../LumiTracer/src/Texture.cpp",
+   }
+
+   includedirs
+   {
+      "../Walnut/vendor/glm",
+      "../Walnut/vendor/stb_image",
+
+      "../LumiTracer/src",
+   }
+
+   defines { "LUX_HEADLESS" }
+
+   links { "pthread", "tbb" }
+
+   targetdir ("../bin/" .. outputdir .. "/bin/%{prj.name}")
+   objdir ("../bin/" .. outputdir .. "/int/%{prj.name}")
+
+   filter "configurations:Debug"
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   filter "configurations:Dist"
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
@@ -0,0 +1,180 @@
+#include "JobScheduler.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace {
+	// Binary PPM, flipped so the renderer's bottom-up rows come out top-down
+	static bool writePPM(const std::string& path, const glm::u32* pixels, const glm::u32vec2 size) {
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out << "P6\n" << size.x << " " << size.y << "\n255\n";
+
+		std::vector<char> row(size.x * 3);
+		for (glm::u32 y = size.y; y-- > 0;) {
+			for (glm::u32 x = 0; x < size.x; x++) {
+				const glm::u32 pixel = pixels[x + static_cast<std::size_t>(y) * size.x];
+				row[x * 3 + 0] = static_cast<char>(pixel & 0xFF);
+				row[x * 3 + 1] = static_cast<char>((pixel >> 8) & 0xFF);
+				row[x * 3 + 2] = static_cast<char>((pixel >> 16) & 0xFF);
+			}
+			out.write(row.data(), row.size());
+		}
+
+		return static_cast<bool>(out);
+	}
+}
+
+JobScheduler::JobScheduler(const glm::u32 workerCount, RowPool* rowPool)
+	: mMutex()
+	, mWakeup()
+	, mQueue()
+	, mNextSequence(0)
+	, mStopping(false)
+	, mPoolMutex()
+	, mRendererPool()
+	, mRowPool(rowPool)
+	, mWorkers()
+	, mRunning(0)
+{
+	for (glm::u32 i = 0; i < std::max(workerCount, 1u); i++) {
+		mWorkers.emplace_back(&JobScheduler::WorkerLoop, this);
+	}
+}
+
+JobScheduler::~JobScheduler() {
+	{
+		std::scoped_lock lock(mMutex);
+		mStopping = true;
+	}
+	mWakeup.notify_all();
+
+	for (std::thread& worker : mWorkers) {
+		worker.join();
+	}
+
+	while (!mQueue.empty()) {
+		const std::shared_ptr<RenderJob> job = mQueue.top();
+		mQueue.pop();
+		job->result.set_value("error " + std::to_string(job->id) + " server shutting down");
+	}
+}
+
+std::future<std::string> JobScheduler::Submit(std::shared_ptr<RenderJob> job) {
+	std::future<std::string> result = job->result.get_future();
+	job->submitted = std::chrono::steady_clock::now();
+
+	{
+		std::scoped_lock lock(mMutex);
+		job->sequence = mNextSequence++;
+		mQueue.push(std::move(job));
+	}
+	mWakeup.notify_one();
+
+	return result;
+}
+
+std::size_t JobScheduler::GetQueued() const {
+	std::scoped_lock lock(mMutex);
+	return mQueue.size();
+}
+
+void JobScheduler::WorkerLoop() {
+	while (true) {
+		std::shared_ptr<RenderJob> job;
+
+		{
+			std::unique_lock lock(mMutex);
+			mWakeup.wait(lock, [this] { return mStopping || !mQueue.empty(); });
+
+			if (mStopping) {
+				return;
+			}
+
+			job = mQueue.top();
+			mQueue.pop();
+			mRunning++;
+		}
+
+		// A job that can't render fails on its own instead of terminating the server
+		std::string failure;
+		try {
+			if (!job->renderer) {
+				job->renderer = this->AcquireRenderer(job->camera.GetRegionSize());
+				job->renderer->SetMaxBounces(job->bounces);
+				job->renderer->SetTextureCache(job->scene->textures.get());
+				job->renderer->SetGeometryStore(job->scene->geometry.get());
+				job->renderer->SetLightTree(&job->scene->lights);
+				job->renderer->SetRowPool(mRowPool);
+				job->renderer->GetFlags() |= Renderer::Flags::Accumulate;
+				job->renderer->GetFlags() |= Renderer::Flags::LightSampling;
+				job->renderer->ResetAccumulationFrames();
+			}
+
+			job->renderer->Render(job->scene->scene, job->camera);
+			job->samplesDone++;
+		} catch (const std::bad_alloc&) {
+			failure = "out of memory";
+		} catch (const std::exception& exception) {
+			failure = exception.what();
+		}
+
+		if (!failure.empty()) {
+			// Not pooled, so whatever the renderer did manage to allocate is freed right away
+			job->renderer.reset();
+			job->scene.reset();
+			job->result.set_value("error " + std::to_string(job->id) + " " + failure);
+		} else if (job->samplesDone >= job->samples) {
+			this->Finish(*job);
+		} else {
+			std::scoped_lock lock(mMutex);
+			job->sequence = mNextSequence++;
+			mQueue.push(std::move(job));
+			mWakeup.notify_one();
+		}
+
+		mRunning--;
+	}
+}
+
+void JobScheduler::Finish(RenderJob& job) {
+	const bool written = writePPM(job.outputPath, job.renderer->GetFinalImageData(), job.renderer->GetViewport());
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - job.submitted);
+
+	this->ReleaseRenderer(std::move(job.renderer));
+	job.scene.reset();
+
+	if (written) {
+		job.result.set_value("done " + std::to_string(job.id) + " " + std::to_string(elapsed.count()));
+	} else {
+		job.result.set_value("error " + std::to_string(job.id) + " cannot write " + job.outputPath);
+	}
+}
+
+std::unique_ptr<Renderer> JobScheduler::AcquireRenderer(const glm::u32vec2 size) {
+	std::scoped_lock lock(mPoolMutex);
+
+	if (mRendererPool.empty()) {
+		return std::make_unique<Renderer>();
+	}
+
+	// Prefer a renderer whose buffers already match, otherwise any idle one saves the allocation bookkeeping
+	auto it = std::find_if(mRendererPool.begin(), mRendererPool.end(), [size](const std::unique_ptr<Renderer>& renderer) {
+		return renderer->GetViewport() == size;
+	});
+
+	if (it == mRendererPool.end()) {
+		it = mRendererPool.end() - 1;
+	}
+
+	std::unique_ptr<Renderer> renderer = std::move(*it);
+	mRendererPool.erase(it);
+	return renderer;
+}
+
+void JobScheduler::ReleaseRenderer(std::unique_ptr<Renderer> renderer) {
+	std::scoped_lock lock(mPoolMutex);
+
+	if (mRendererPool.size() < mWorkers.size() * 2) {
+		mRendererPool.push_back(std::move(renderer));
+	}
+}
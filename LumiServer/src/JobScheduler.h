@@ -0,0 +1,86 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Camera.h"
+#include "Renderer.h"
+#include "RowPool.h"
+#include "SceneCache.h"
+
+struct RenderJob {
+    std::uint64_t id = 0;
+    int priority = 0;
+    std::shared_ptr<CachedScene> scene;
+    // A crop is the camera's region, so only its pixels are traced, allocated and written
+    Camera camera{ 45.0f, 0.1f, 200.0f };
+    glm::u32 samples = 1;
+    int bounces = 10;
+    std::string outputPath;
+
+    // Scheduling state
+    std::unique_ptr<Renderer> renderer;
+    glm::u32 samplesDone = 0;
+    std::uint64_t sequence = 0;
+    std::chrono::steady_clock::time_point submitted;
+    std::promise<std::string> result;
+};
+
+// Runs jobs one sample at a time. After every sample a job goes to the back of its priority level, so
+// concurrent jobs of equal priority share the renderer's thread pool evenly.
+class JobScheduler {
+public:
+    // Renderers trace on `rowPool` if it isn't null. Its workers serve one frame at a time.
+    JobScheduler(const glm::u32 workerCount, RowPool* rowPool);
+    ~JobScheduler();
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    // Resolves to "done <id> <ms>" or "error <id> <message>" once the image is written.
+    std::future<std::string> Submit(std::shared_ptr<RenderJob> job);
+
+    [[nodiscard]] std::size_t GetQueued() const;
+    [[nodiscard]] glm::u32 GetRunning() const { return mRunning; }
+
+private:
+    struct Order {
+        bool operator()(const std::shared_ptr<RenderJob>& lhs, const std::shared_ptr<RenderJob>& rhs) const {
+            if (lhs->priority != rhs->priority) {
+                return lhs->priority < rhs->priority;
+            }
+            return lhs->sequence > rhs->sequence;
+        }
+    };
+
+    void WorkerLoop();
+    void Finish(RenderJob& job);
+
+    std::unique_ptr<Renderer> AcquireRenderer(const glm::u32vec2 size);
+    void ReleaseRenderer(std::unique_ptr<Renderer> renderer);
+
+private:
+    mutable std::mutex mMutex;
+    std::condition_variable mWakeup;
+    std::priority_queue<std::shared_ptr<RenderJob>, std::vector<std::shared_ptr<RenderJob>>, Order> mQueue;
+    std::uint64_t mNextSequence;
+    bool mStopping;
+
+    // Idle renderers keep their buffers so back-to-back jobs of the same size skip allocation
+    std::mutex mPoolMutex;
+    std::vector<std::unique_ptr<Renderer>> mRendererPool;
+
+    RowPool* mRowPool;
+    std::vector<std::thread> mWorkers;
+    std::atomic<glm::u32> mRunning;
+};
@@ -0,0 +1,71 @@
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "JobScheduler.h"
+#include "RowPool.h"
+#include "SceneCache.h"
+#include "Server.h"
+
+int main(int argc, char** argv) {
+	std::string socketPath = "/tmp/lumitracer.sock";
+	glm::u32 workers = 2;
+	std::size_t sceneCapacity = 4;
+	std::size_t textureBudget = 1024;
+	std::size_t geometryBudget = 4096;
+	std::string textureCacheDirectory;
+	bool pinThreads = false;
+	Server::Limits limits;
+
+	for (int i = 1; i < argc; i++) {
+		const bool hasValue = i + 1 < argc;
+
+		try {
+			if (std::strcmp(argv[i], "--socket") == 0 && hasValue) {
+				socketPath = argv[++i];
+			} else if (std::strcmp(argv[i], "--workers") == 0 && hasValue) {
+				workers = static_cast<glm::u32>(std::stoul(argv[++i]));
+			} else if (std::strcmp(argv[i], "--scenes") == 0 && hasValue) {
+				sceneCapacity = std::stoul(argv[++i]);
+			} else if (std::strcmp(argv[i], "--texture-budget") == 0 && hasValue) {
+				textureBudget = std::stoul(argv[++i]);
+			} else if (std::strcmp(argv[i], "--geometry-budget") == 0 && hasValue) {
+				geometryBudget = std::stoul(argv[++i]);
+			} else if (std::strcmp(argv[i], "--texture-cache") == 0 && hasValue) {
+				textureCacheDirectory = argv[++i];
+			} else if (std::strcmp(argv[i], "--max-size") == 0 && hasValue) {
+				limits.maxSize = static_cast<glm::u32>(std::stoul(argv[++i]));
+			} else if (std::strcmp(argv[i], "--max-pixels") == 0 && hasValue) {
+				limits.maxPixels = std::stoull(argv[++i]);
+			} else if (std::strcmp(argv[i], "--max-spp") == 0 && hasValue) {
+				limits.maxSamples = static_cast<glm::u32>(std::stoul(argv[++i]));
+			} else if (std::strcmp(argv[i], "--pin-threads") == 0) {
+				pinThreads = true;
+			} else {
+				std::cerr << "usage: " << argv[0] << " [--socket path] [--workers n] [--scenes n] [--texture-budget MiB] [--geometry-budget MiB]"
+					<< " [--texture-cache dir] [--max-size pixels] [--max-pixels n] [--max-spp n] [--pin-threads]" << std::endl;
+				return 1;
+			}
+		} catch (const std::exception&) {
+			std::cerr << "malformed value for " << argv[i - 1] << std::endl;
+			return 1;
+		}
+	}
+
+	SceneCache scenes(sceneCapacity, textureBudget << 20, geometryBudget << 20, textureCacheDirectory);
+	// Frames from all workers share the pinned pool, so each one gets every core in turn
+	std::unique_ptr<RowPool> rowPool = pinThreads ? std::make_unique<RowPool>() : nullptr;
+	JobScheduler scheduler(workers, rowPool.get());
+	Server server(socketPath, scenes, scheduler, limits);
+
+	std::cout << "lumiserver listening on " << socketPath << std::endl;
+
+	std::string error;
+	if (!server.Run(error)) {
+		std::cerr << error << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
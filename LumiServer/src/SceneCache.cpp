@@ -0,0 +1,123 @@
+#include "SceneCache.h"
+
+#include "SceneFile.h"
+
+SceneCache::SceneCache(const std::size_t capacity, const std::size_t textureBudget, const std::size_t geometryBudget, const std::string& textureCacheDirectory)
+	: mMutex()
+	, mLRU()
+	, mLookup()
+	, mLoading()
+	, mCapacity(std::max<std::size_t>(capacity, 1))
+	, mTextureBudget(textureBudget)
+	, mGeometryBudget(geometryBudget)
+	, mTextureCacheDirectory(textureCacheDirectory)
+{ }
+
+std::shared_ptr<CachedScene> SceneCache::Acquire(const std::string& path, std::string& error) {
+	std::error_code timeError;
+	const std::filesystem::file_time_type timestamp = std::filesystem::last_write_time(path, timeError);
+
+	std::promise<LoadResult> promise;
+	std::shared_future<LoadResult> pending;
+
+	{
+		std::scoped_lock lock(mMutex);
+
+		const auto it = mLookup.find(path);
+		if (it != mLookup.end()) {
+			if (!timeError && it->second->second->timestamp == timestamp) {
+				mLRU.splice(mLRU.begin(), mLRU, it->second);
+				return it->second->second;
+			}
+
+			// Stale, jobs still holding the old copy keep it alive until they finish
+			mLRU.erase(it->second);
+			mLookup.erase(it);
+		}
+
+		const auto loading = mLoading.find(path);
+		if (loading != mLoading.end()) {
+			pending = loading->second;
+		} else {
+			mLoading[path] = promise.get_future().share();
+		}
+	}
+
+	// Someone else is already loading this scene
+	if (pending.valid()) {
+		const LoadResult& result = pending.get();
+		if (!result.scene) {
+			error = result.error;
+		}
+		return result.scene;
+	}
+
+	// Waiters block on the promise, so it has to be fulfilled whatever loading does
+	LoadResult result;
+	try {
+		result.scene = this->Load(path, result.error);
+	} catch (const std::bad_alloc&) {
+		result.scene = nullptr;
+		result.error = "out of memory loading " + path;
+	} catch (const std::exception& exception) {
+		result.scene = nullptr;
+		result.error = "cannot load " + path + ": " + exception.what();
+	}
+
+	if (result.scene) {
+		result.scene->timestamp = timestamp;
+	}
+
+	{
+		std::scoped_lock lock(mMutex);
+		mLoading.erase(path);
+
+		if (result.scene) {
+			mLRU.emplace_front(path, result.scene);
+			mLookup[path] = mLRU.begin();
+
+			while (mLRU.size() > mCapacity) {
+				mLookup.erase(mLRU.back().first);
+				mLRU.pop_back();
+			}
+		}
+	}
+
+	promise.set_value(result);
+
+	if (!result.scene) {
+		error = result.error;
+	}
+	return result.scene;
+}
+
+std::size_t SceneCache::GetSize() const {
+	std::scoped_lock lock(mMutex);
+	return mLRU.size();
+}
+
+std::shared_ptr<CachedScene> SceneCache::Load(const std::string& path, std::string& error) const {
+	SceneFile file;
+	if (!LoadSceneFile(path, file, error)) {
+		return nullptr;
+	}
+
+	auto scene = std::make_shared<CachedScene>();
+	scene->scene = std::move(file.scene);
+
+	// Budgets are split evenly so a full cache stays within the configured totals
+	scene->textures = std::make_unique<TextureCache>(mTextureBudget / mCapacity);
+	scene->textures->SetCacheDirectory(mTextureCacheDirectory);
+	scene->textures->Sync(scene->scene.textures);
+	scene->lights.Update(scene->scene);
+
+	if (!file.geometryPath.empty()) {
+		scene->geometry = std::make_unique<GeometryStore>(mGeometryBudget / mCapacity);
+		if (!scene->geometry->Open(file.geometryPath)) {
+			error = "cannot open geometry " + file.geometryPath;
+			return nullptr;
+		}
+	}
+
+	return scene;
+}
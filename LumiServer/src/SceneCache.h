@@ -0,0 +1,57 @@
+#pragma once
+
+#include <filesystem>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "Geometry.h"
+#include "LightTree.h"
+#include "Scene.h"
+#include "Texture.h"
+
+// A loaded scene together with everything prepared for rendering it.
+struct CachedScene {
+    Scene scene;
+    std::unique_ptr<TextureCache> textures;
+    std::unique_ptr<GeometryStore> geometry;
+    LightTree lights;
+    std::filesystem::file_time_type timestamp;
+};
+
+// Keeps recently used scenes resident so repeated jobs skip loading and preparation.
+class SceneCache {
+public:
+    // Tiled textures go to `textureCacheDirectory`, or next to their images if it's empty.
+    SceneCache(const std::size_t capacity, const std::size_t textureBudget, const std::size_t geometryBudget, const std::string& textureCacheDirectory);
+
+    // Returns the scene at `path`, loading it if it isn't cached or has changed on disk. Loading happens
+    // outside the cache lock; concurrent requests for the same path wait on a single load.
+    std::shared_ptr<CachedScene> Acquire(const std::string& path, std::string& error);
+
+    [[nodiscard]] std::size_t GetSize() const;
+
+private:
+    std::shared_ptr<CachedScene> Load(const std::string& path, std::string& error) const;
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<CachedScene>>;
+
+    struct LoadResult {
+        std::shared_ptr<CachedScene> scene;
+        std::string error;
+    };
+
+    mutable std::mutex mMutex;
+    std::list<Entry> mLRU;
+    std::unordered_map<std::string, std::list<Entry>::iterator> mLookup;
+    std::unordered_map<std::string, std::shared_future<LoadResult>> mLoading;
+
+    std::size_t mCapacity;
+    std::size_t mTextureBudget;
+    std::size_t mGeometryBudget;
+    std::string mTextureCacheDirectory;
+};
@@ -0,0 +1,230 @@
+#include "Server.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <sstream>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+	static void sendLine(const int socket, const std::string& line) {
+		const std::string message = line + "\n";
+		send(socket, message.data(), message.size(), MSG_NOSIGNAL);
+	}
+
+	static bool readLine(const int socket, std::string& line) {
+		line.clear();
+
+		char c;
+		while (recv(socket, &c, 1, 0) == 1) {
+			if (c == '\n') {
+				return true;
+			}
+			line += c;
+		}
+
+		return !line.empty();
+	}
+
+	static bool parseRect(const std::string& text, glm::u32vec2& min, glm::u32vec2& max) {
+		return std::sscanf(text.c_str(), "%u,%u,%u,%u", &min.x, &min.y, &max.x, &max.y) == 4;
+	}
+
+	// Throws like std::stoul, and for values above `max`. Negative input is caught here too, stoul wraps it.
+	static glm::u32 parseCount(const std::string& text, const glm::u32 max) {
+		const unsigned long value = std::stoul(text);
+		if (value > max) {
+			throw std::out_of_range("above " + std::to_string(max));
+		}
+		return static_cast<glm::u32>(value);
+	}
+
+	static bool parseVec3(const std::string& text, glm::vec3& value) {
+		return std::sscanf(text.c_str(), "%f,%f,%f", &value.x, &value.y, &value.z) == 3;
+	}
+}
+
+Server::Server(const std::string& socketPath, SceneCache& scenes, JobScheduler& scheduler, const Limits& limits)
+	: mSocketPath(socketPath)
+	, mScenes(scenes)
+	, mScheduler(scheduler)
+	, mLimits(limits)
+	, mListener(-1)
+	, mRunning(false)
+	, mNextJobId(1)
+{ }
+
+bool Server::Run(std::string& error) {
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+
+	if (mSocketPath.size() >= sizeof(address.sun_path)) {
+		error = "socket path too long";
+		return false;
+	}
+	mSocketPath.copy(address.sun_path, mSocketPath.size());
+
+	mListener = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(mSocketPath.c_str());
+
+	if (mListener < 0 || bind(mListener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(mListener, 16) != 0) {
+		error = "cannot listen on " + mSocketPath;
+		return false;
+	}
+
+	mRunning = true;
+	while (mRunning) {
+		const int client = accept(mListener, nullptr, nullptr);
+		if (client < 0) {
+			continue;
+		}
+
+		// Render requests wait for their job, so every connection gets its own thread
+		std::thread(&Server::HandleConnection, this, client).detach();
+	}
+
+	close(mListener);
+	unlink(mSocketPath.c_str());
+
+	return true;
+}
+
+void Server::HandleConnection(const int client) {
+	std::string line;
+	if (readLine(client, line)) {
+		// Runs on a detached thread, anything escaping here would take the whole daemon down
+		try {
+			std::istringstream stream(line);
+
+			std::string command;
+			stream >> command;
+
+			if (command == "render") {
+				std::string arguments;
+				std::getline(stream, arguments);
+				sendLine(client, this->Submit(arguments, client));
+			} else if (command == "status") {
+				sendLine(client, "jobs " + std::to_string(mScheduler.GetQueued()) + " queued " + std::to_string(mScheduler.GetRunning()) + " running, "
+					+ std::to_string(mScenes.GetSize()) + " scenes cached");
+			} else if (command == "shutdown") {
+				mRunning = false;
+				shutdown(mListener, SHUT_RDWR);
+				sendLine(client, "bye");
+			} else {
+				sendLine(client, "error unknown command '" + command + "'");
+			}
+		} catch (const std::bad_alloc&) {
+			sendLine(client, "error out of memory");
+		} catch (const std::exception& exception) {
+			sendLine(client, std::string("error ") + exception.what());
+		}
+	}
+
+	close(client);
+}
+
+std::string Server::Submit(const std::string& arguments, const int client) {
+	auto job = std::make_shared<RenderJob>();
+	job->id = mNextJobId++;
+
+	std::string scenePath;
+	glm::u32 width = 640, height = 360;
+	glm::vec3 position(0.0f, 0.0f, 3.0f);
+	glm::vec3 direction(0.0f, 0.0f, -1.0f);
+	bool crop = false;
+	glm::u32vec2 cropMin(0, 0), cropMax(0, 0);
+
+	std::istringstream stream(arguments);
+	std::string argument;
+	while (stream >> argument) {
+		const std::size_t separator = argument.find('=');
+		if (separator == std::string::npos) {
+			return "error malformed argument '" + argument + "'";
+		}
+
+		const std::string key = argument.substr(0, separator);
+		const std::string value = argument.substr(separator + 1);
+
+		try {
+			if (key == "scene") {
+				scenePath = value;
+			} else if (key == "out") {
+				job->outputPath = value;
+			} else if (key == "width") {
+				width = parseCount(value, mLimits.maxSize);
+			} else if (key == "height") {
+				height = parseCount(value, mLimits.maxSize);
+			} else if (key == "spp") {
+				job->samples = parseCount(value, mLimits.maxSamples);
+			} else if (key == "bounces") {
+				job->bounces = std::stoi(value);
+			} else if (key == "priority") {
+				job->priority = std::stoi(value);
+			} else if (key == "position") {
+				if (!parseVec3(value, position)) {
+					return "error malformed position '" + value + "'";
+				}
+			} else if (key == "direction") {
+				if (!parseVec3(value, direction)) {
+					return "error malformed direction '" + value + "'";
+				}
+			} else if (key == "crop") {
+				if (!parseRect(value, cropMin, cropMax)) {
+					return "error malformed crop '" + value + "'";
+				}
+				crop = true;
+			} else {
+				return "error unknown argument '" + key + "'";
+			}
+		} catch (const std::exception&) {
+			return "error malformed value for '" + key + "'";
+		}
+	}
+
+	if (scenePath.empty() || job->outputPath.empty()) {
+		return "error render needs scene= and out=";
+	}
+
+	if (!std::filesystem::path(scenePath).is_absolute() || !std::filesystem::path(job->outputPath).is_absolute()) {
+		return "error scene= and out= must be absolute paths";
+	}
+
+	if (width == 0 || height == 0 || job->samples == 0) {
+		return "error width, height and spp must be positive";
+	}
+
+	if (static_cast<std::uint64_t>(width) * height > mLimits.maxPixels) {
+		return "error image larger than " + std::to_string(mLimits.maxPixels) + " pixels";
+	}
+
+	glm::u32vec2 regionMin(0, 0), regionMax(width, height);
+	if (crop) {
+		if (cropMin.x >= cropMax.x || cropMin.y >= cropMax.y || cropMax.x > width || cropMax.y > height) {
+			return "error crop must be x0,y0,x1,y1 inside the image";
+		}
+
+		// Crop is given top-down like the written image, the camera counts rows from the bottom
+		regionMin = { cropMin.x, height - cropMax.y };
+		regionMax = { cropMax.x, height - cropMin.y };
+	}
+
+	std::string error;
+	job->scene = mScenes.Acquire(scenePath, error);
+	if (!job->scene) {
+		return "error " + error;
+	}
+
+	job->camera.SetView(position, direction);
+	job->camera.ResizeRegion(width, height, regionMin, regionMax);
+
+	const std::uint64_t id = job->id;
+	std::future<std::string> result = mScheduler.Submit(std::move(job));
+
+	sendLine(client, "queued " + std::to_string(id));
+
+	return result.get();
+}
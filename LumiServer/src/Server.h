@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "JobScheduler.h"
+#include "SceneCache.h"
+
+// Accepts one command per connection on a Unix domain socket:
+//
+//   render scene=<path> out=<path.ppm> [width=W] [height=H] [spp=N] [bounces=N] [priority=P]
+//          [position=x,y,z] [direction=x,y,z] [crop=x0,y0,x1,y1]
+//   status
+//   shutdown
+//
+// `render` replies "queued <id>" right away and "done <id> <ms>" or "error <id> <message>" when the image is written.
+// Paths must be absolute, the daemon's working directory means nothing to its clients. With `crop` only that
+// region, in top-down image pixels, is traced and written.
+class Server {
+public:
+    // Requests beyond these are rejected before anything is allocated for them.
+    struct Limits {
+        glm::u32 maxSize = 16384;
+        std::uint64_t maxPixels = 64ull << 20;
+        glm::u32 maxSamples = 1u << 16;
+    };
+
+    Server(const std::string& socketPath, SceneCache& scenes, JobScheduler& scheduler, const Limits& limits);
+
+    // Blocks until a shutdown command arrives.
+    bool Run(std::string& error);
+
+private:
+    void HandleConnection(const int client);
+    std::string Submit(const std::string& arguments, const int client);
+
+private:
+    std::string mSocketPath;
+    SceneCache& mScenes;
+    JobScheduler& mScheduler;
+    Limits mLimits;
+
+    int mListener;
+    std::atomic<bool> mRunning;
+    std::atomic<std::uint64_t> mNextJobId;
+};
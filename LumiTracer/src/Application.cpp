@@ -12,7 +12,11 @@
 
 #include "Renderer.h"
 #include "Camera.h"
+#include "Geometry.h"
+#include "LightTree.h"
+#include "RowPool.h"
 #include "Scene.h"
+#include "Texture.h"
 
 class MainLayer : public Walnut::Layer {
 public:
@@ -20,14 +24,25 @@ public:
 		: Walnut::Layer()
 		, mViewport()
 		, mLastRenderTime(-1.0f)
+		, mCropDragging(false)
+		, mCropStart(0.0f)
+		, mCropEnd(0.0f)
 		, mCamera(45.0f, 0.1f, 200.0f)
 		, mRenderer()
+		, mFinalImage()
 		, mScene()
+		, mTextureCache()
+		, mGeometryStore()
+		, mLightTree()
+		, mRowPool()
 	{
 		extern void UIStyle();
 		UIStyle();
 
 		mCamera.SetSensitivity(0.004f);
+		mRenderer.SetTextureCache(&mTextureCache);
+		mRenderer.SetGeometryStore(&mGeometryStore);
+		mRenderer.SetLightTree(&mLightTree);
 
 		mScene.materials.push_back({
 			.albedo = glm::vec3(0.0f),
@@ -70,6 +85,8 @@ public:
 			.radius = 0.75f,
 			.materialIndex = 2
 		});
+
+		mLightTree.Update(mScene);
 	}
 
 	void OnUpdate(glm::f32 ts) override {
@@ -88,6 +105,16 @@ public:
 
 			ImGui::Text("Viewport: %i pixels", mViewport.x * mViewport.y);
 
+			if (mRenderer.HasCropWindow()) {
+				ImGui::Text("Crop: %ix%i", static_cast<int>(glm::abs(mCropEnd.x - mCropStart.x)), static_cast<int>(glm::abs(mCropEnd.y - mCropStart.y)));
+				ImGui::SameLine();
+				if (ImGui::Button("Clear crop")) {
+					mRenderer.ClearCropWindow();
+				}
+			} else {
+				ImGui::TextDisabled("Drag in the viewport to crop");
+			}
+
 			static bool accumulate = false;
 			ImGui::Checkbox("Accumulate", &accumulate);
 			ImGui::SameLine();
@@ -106,8 +133,63 @@ public:
 			ImGui::SliderInt("Ray bounces", &bounceCount, 0, 30);
 			mRenderer.SetMaxBounces(bounceCount);
 
+			static bool lightSampling = true;
+			ImGui::Checkbox("Light sampling", &lightSampling);
+			ImGui::SameLine();
+			ImGui::Text("%i emitters", mLightTree.GetLightCount());
+			if (lightSampling) {
+				mRenderer.GetFlags() |= Renderer::Flags::LightSampling;
+			} else {
+				mRenderer.GetFlags() &= ~Renderer::Flags::LightSampling;
+			}
+
+			// Pins one worker per CPU so each row's pixels stay on the NUMA node that traces it
+			bool pinThreads = mRowPool != nullptr;
+			if (ImGui::Checkbox("Pin threads", &pinThreads)) {
+				mRowPool = pinThreads ? std::make_unique<RowPool>() : nullptr;
+				mRenderer.SetRowPool(mRowPool.get());
+			}
+
+			static int textureBudget = 512;
+			ImGui::SliderInt("Texture budget (MiB)", &textureBudget, 16, 8192);
+			mTextureCache.SetBudget(static_cast<std::size_t>(textureBudget) << 20);
+			ImGui::Text("Texture cache: %.1f MiB resident", static_cast<glm::f32>(mTextureCache.GetResidentBytes()) / (1024.0f * 1024.0f));
+
+			if (ImGui::CollapsingHeader("Out-of-core geometry")) {
+				static char spherePath[256] = "";
+				static bool quantize = true;
+				static int chunkSize = 65536;
+				ImGui::InputText("Sphere file", spherePath, sizeof(spherePath));
+				ImGui::InputInt("Chunk size", &chunkSize, 1024, 16384);
+				ImGui::Checkbox("Quantize", &quantize);
+
+				if (ImGui::Button("Export scene spheres")) {
+					GeometryStore::Export(mScene.spheres, spherePath);
+				}
+				ImGui::SameLine();
+				if (ImGui::Button("Build & open")) {
+					const std::string chunkedPath = std::string(spherePath) + ".luxgeo";
+					if (GeometryStore::Build(spherePath, chunkedPath, static_cast<glm::u32>(std::max(chunkSize, 1)), quantize)) {
+						mGeometryStore.Open(chunkedPath);
+					}
+					mRenderer.ResetAccumulationFrames();
+				}
+				ImGui::SameLine();
+				if (ImGui::Button("Close")) {
+					mGeometryStore.Close();
+					mRenderer.ResetAccumulationFrames();
+				}
+
+				static int geometryBudget = 1024;
+				ImGui::SliderInt("Geometry budget (MiB)", &geometryBudget, 16, 65536);
+				mGeometryStore.SetBudget(static_cast<std::size_t>(geometryBudget) << 20);
+				ImGui::Text("Chunks: %i, %.1f MiB resident, %llu loads", static_cast<int>(mGeometryStore.GetChunks().size()),
+					static_cast<glm::f32>(mGeometryStore.GetResidentBytes()) / (1024.0f * 1024.0f), static_cast<unsigned long long>(mGeometryStore.GetChunkLoads()));
+			}
+
 		} ImGui::End();
 
+		bool sceneChanged = false;
 		if (ImGui::Begin("Scene")) {
 			ImGui::Text("Spheres:");
 			ImGui::Indent();
@@ -115,9 +197,9 @@ public:
 				ImGui::PushID(i);
 
 				Sphere& sphere = mScene.spheres[i];
-				ImGui::DragFloat3("Position", glm::value_ptr(sphere.position), 0.1f);
-				ImGui::DragFloat("Radius", &sphere.radius, 0.1f);
-				ImGui::InputInt("Material", &sphere.materialIndex, 1, 1);
+				sceneChanged |= ImGui::DragFloat3("Position", glm::value_ptr(sphere.position), 0.1f);
+				sceneChanged |= ImGui::DragFloat("Radius", &sphere.radius, 0.1f);
+				sceneChanged |= ImGui::InputInt("Material", &sphere.materialIndex, 1, 1);
 				
 				if (i != mScene.spheres.size() - 1) {
 					ImGui::Separator();
@@ -135,8 +217,12 @@ public:
 				ImGui::ColorEdit3("Albedo", glm::value_ptr(material.albedo));
 				ImGui::SliderFloat("Roughness", &material.roughness, 0.0f, 1.0f);
 				ImGui::SliderFloat("Metallic", &material.metallic, 0.0f, 1.0f);
-				ImGui::ColorEdit3("Emissive Color", glm::value_ptr(material.emissiveColor));
-				ImGui::SliderFloat("Emissive Strength", &material.emissiveStrength, 0.0f, 10.0f);
+				sceneChanged |= ImGui::ColorEdit3("Emissive Color", glm::value_ptr(material.emissiveColor));
+				sceneChanged |= ImGui::SliderFloat("Emissive Strength", &material.emissiveStrength, 0.0f, 10.0f);
+				ImGui::InputInt("Albedo Map", &material.albedoTexture, 1, 1);
+				ImGui::InputInt("Roughness Map", &material.roughnessTexture, 1, 1);
+				ImGui::InputInt("Metallic Map", &material.metallicTexture, 1, 1);
+				ImGui::InputInt("Emissive Map", &material.emissiveTexture, 1, 1);
 
 				if (i != mScene.materials.size() - 1) {
 					ImGui::Separator();
@@ -145,36 +231,121 @@ public:
 				ImGui::PopID();
 			}
 			ImGui::Unindent();
+			ImGui::Text("Textures:");
+			ImGui::Indent();
+			for (int i = 0; i < mScene.textures.size(); i++) {
+				ImGui::Text("%i: %s", i, mScene.textures[i].c_str());
+			}
+
+			static char texturePath[256] = "";
+			ImGui::InputText("##TexturePath", texturePath, sizeof(texturePath));
+			ImGui::SameLine();
+			if (ImGui::Button("Add Texture") && texturePath[0] != '\0') {
+				mScene.textures.push_back(texturePath);
+				texturePath[0] = '\0';
+			}
+			ImGui::Unindent();
 		} ImGui::End();
 
+		// Emitters moved or changed, refit the light tree (or rebuild it if the set of emitters changed)
+		if (sceneChanged) {
+			mLightTree.Update(mScene);
+		}
+
 		ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, { 0.0f, 0.0f });
 		if (ImGui::Begin("Viewport")) {
-			mViewport.x = static_cast<glm::u32>(ImGui::GetContentRegionAvail().x);
-			mViewport.y = static_cast<glm::u32>(ImGui::GetContentRegionAvail().y);
+			const glm::u32vec2 viewport = {
+				static_cast<glm::u32>(ImGui::GetContentRegionAvail().x),
+				static_cast<glm::u32>(ImGui::GetContentRegionAvail().y)
+			};
+
+			// The crop rectangle is in pixels of the old size
+			if (viewport != mViewport && mRenderer.HasCropWindow()) {
+				mRenderer.ClearCropWindow();
+			}
+			mViewport = viewport;
 
-			if (mRenderer.GetFinalImage()) {
-				ImGui::Image(mRenderer.GetFinalImage()->GetDescriptorSet(), { static_cast<glm::f32>(mViewport.x), static_cast<glm::f32>(mViewport.y) }, { 0, 1 }, { 1, 0 });
+			if (mFinalImage) {
+				const ImVec2 origin = ImGui::GetCursorScreenPos();
+				ImGui::Image(mFinalImage->GetDescriptorSet(), { static_cast<glm::f32>(mViewport.x), static_cast<glm::f32>(mViewport.y) }, { 0, 1 }, { 1, 0 });
+				this->UpdateCropWindow({ origin.x, origin.y });
 			}
 		} ImGui::End(); ImGui::PopStyleVar();
 
 		this->RenderImage();
 	}
 
+	void UpdateCropWindow(const glm::vec2 origin) {
+		const ImVec2 mouse = ImGui::GetMousePos();
+		const glm::vec2 position = glm::clamp(glm::vec2(mouse.x, mouse.y) - origin, glm::vec2(0.0f), glm::vec2(mViewport));
+
+		if (ImGui::IsItemHovered() && ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
+			mCropDragging = true;
+			mCropStart = position;
+		}
+
+		if (mCropDragging) {
+			mCropEnd = position;
+
+			if (ImGui::IsMouseReleased(ImGuiMouseButton_Left)) {
+				mCropDragging = false;
+
+				const glm::vec2 min = glm::min(mCropStart, mCropEnd);
+				const glm::vec2 max = glm::max(mCropStart, mCropEnd);
+
+				// A click without a drag clears the crop
+				if (max.x - min.x < 2.0f || max.y - min.y < 2.0f) {
+					mRenderer.ClearCropWindow();
+				} else {
+					// The image is drawn flipped, the renderer's rows start at the bottom
+					mRenderer.SetCropWindow(
+						{ static_cast<glm::u32>(min.x), mViewport.y - static_cast<glm::u32>(max.y) },
+						{ static_cast<glm::u32>(max.x), mViewport.y - static_cast<glm::u32>(min.y) }
+					);
+				}
+			}
+		}
+
+		if (mCropDragging || mRenderer.HasCropWindow()) {
+			const glm::vec2 min = origin + glm::min(mCropStart, mCropEnd);
+			const glm::vec2 max = origin + glm::max(mCropStart, mCropEnd);
+			ImGui::GetWindowDrawList()->AddRect({ min.x, min.y }, { max.x, max.y }, IM_COL32(255, 200, 0, 255));
+		}
+	}
+
 	void RenderImage() {
 		Walnut::Timer timer;
 
 		mCamera.Resize(mViewport.x, mViewport.y);
 		mRenderer.Render(mScene, mCamera);
 
+		const glm::u32vec2 size = mRenderer.GetViewport();
+		if (size.x != 0 && size.y != 0) {
+			if (!mFinalImage) {
+				mFinalImage = std::make_unique<Walnut::Image>(size.x, size.y, Walnut::ImageFormat::RGBA);
+			} else if (mFinalImage->GetWidth() != size.x || mFinalImage->GetHeight() != size.y) {
+				mFinalImage->Resize(size.x, size.y);
+			}
+
+			mFinalImage->SetData(mRenderer.GetFinalImageData());
+		}
+
 		mLastRenderTime = timer.ElapsedMillis();
 	}
 	
 private:
 	glm::u32vec2 mViewport;
 	glm::f32 mLastRenderTime;
+	bool mCropDragging;
+	glm::vec2 mCropStart, mCropEnd;
 	Camera mCamera;
 	Renderer mRenderer;
+	std::unique_ptr<Walnut::Image> mFinalImage;
 	Scene mScene;
+	TextureCache mTextureCache;
+	GeometryStore mGeometryStore;
+	LightTree mLightTree;
+	std::unique_ptr<RowPool> mRowPool;
 };
 
 Walnut::Application* Walnut::CreateApplication(int argc, char** argv) {
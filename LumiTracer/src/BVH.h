@@ -0,0 +1,48 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+// Builds a bounding volume hierarchy over the items in [begin, end) by splitting them at the median of their
+// centers along the axis the centers spread furthest. Nodes are appended to `nodes` depth first, so the left
+// child always directly follows its parent and interior nodes only need to store the index of their right child.
+//
+// `centerOf(item)` returns the position an item is sorted by, `makeLeaf(item)` the leaf holding one item and
+// `makeInterior(left, right, rightIndex)` the node above two finished subtrees. Returns the index of the root.
+template<typename Node, typename CenterOf, typename MakeLeaf, typename MakeInterior>
+glm::u32 BuildMedianSplitBVH(std::vector<Node>& nodes, std::vector<glm::u32>::iterator begin, std::vector<glm::u32>::iterator end,
+    const CenterOf& centerOf, const MakeLeaf& makeLeaf, const MakeInterior& makeInterior) {
+    const glm::u32 nodeIndex = static_cast<glm::u32>(nodes.size());
+    nodes.push_back({});
+
+    if (end - begin == 1) {
+        nodes[nodeIndex] = makeLeaf(*begin);
+        return nodeIndex;
+    }
+
+    glm::vec3 centerMin(std::numeric_limits<glm::f32>::max());
+    glm::vec3 centerMax(std::numeric_limits<glm::f32>::lowest());
+    for (auto it = begin; it != end; ++it) {
+        const glm::vec3 center = centerOf(*it);
+        centerMin = glm::min(centerMin, center);
+        centerMax = glm::max(centerMax, center);
+    }
+
+    const glm::vec3 extent = centerMax - centerMin;
+    const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    const auto middle = begin + (end - begin) / 2;
+    std::nth_element(begin, middle, end, [&centerOf, axis](const glm::u32 lhs, const glm::u32 rhs) {
+        return centerOf(lhs)[axis] < centerOf(rhs)[axis];
+    });
+
+    const glm::u32 left = BuildMedianSplitBVH(nodes, begin, middle, centerOf, makeLeaf, makeInterior);
+    const glm::u32 right = BuildMedianSplitBVH(nodes, middle, end, centerOf, makeLeaf, makeInterior);
+
+    nodes[nodeIndex] = makeInterior(nodes[left], nodes[right], right);
+
+    return nodeIndex;
+}
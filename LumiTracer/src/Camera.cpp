@@ -4,7 +4,9 @@
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 
+#ifndef LUX_HEADLESS
 #include "Walnut/Input/Input.h"
+#endif
 
 Camera::Camera(glm::f32 verticalFOV, glm::f32 nearClip, glm::f32 farClip)
 	: mVerticalFOV(verticalFOV)
@@ -15,6 +17,7 @@ Camera::Camera(glm::f32 verticalFOV, glm::f32 nearClip, glm::f32 farClip)
 	mPosition = glm::vec3(0, 0, 3);
 }
 
+#ifndef LUX_HEADLESS
 bool Camera::OnUpdate(glm::f32 ts) {
 	glm::vec2 mousePos = Walnut::Input::GetMousePosition();
 	glm::vec2 delta = (mousePos - mLastMousePosition) * mSensitivity;
@@ -75,18 +78,41 @@ bool Camera::OnUpdate(glm::f32 ts) {
 
 	return moved;
 }
+#endif
 
 void Camera::Resize(glm::u32 width, glm::u32 height) {
-	if (width == mViewportWidth && height == mViewportHeight)
+	this->ResizeRegion(width, height, { 0, 0 }, { width, height });
+}
+
+void Camera::ResizeRegion(glm::u32 width, glm::u32 height, glm::u32vec2 min, glm::u32vec2 max) {
+	max = glm::min(max, glm::u32vec2(width, height));
+	min = glm::min(min, max);
+
+	const glm::u32vec2 size = max - min;
+	if (width == mViewportWidth && height == mViewportHeight && min == mRegionMin && size == mRegionSize)
 		return;
 
+	// Allocate before changing anything so a failure leaves the camera at its old size
+	std::vector<glm::vec3> rayDirections(static_cast<std::size_t>(size.x) * size.y);
+	mRayDirections.swap(rayDirections);
+
 	mViewportWidth = width;
 	mViewportHeight = height;
+	mRegionMin = min;
+	mRegionSize = size;
 
 	this->RecalculateProjection();
 	this->RecalculateRayDirections();
 }
 
+void Camera::SetView(const glm::vec3& position, const glm::vec3& direction) {
+	mPosition = position;
+	mForwardDirection = glm::normalize(direction);
+
+	this->RecalculateView();
+	this->RecalculateRayDirections();
+}
+
 float Camera::GetRotationSpeed() {
 	return 0.3f;
 }
@@ -102,20 +128,20 @@ void Camera::RecalculateView() {
 }
 
 void Camera::RecalculateRayDirections() {
-	mRayDirections.resize(mViewportWidth * mViewportHeight);
+	mRayDirections.resize(static_cast<std::size_t>(mRegionSize.x) * mRegionSize.y);
 
-	for (uint32_t y = 0; y < mViewportHeight; y++) {
-		for (uint32_t x = 0; x < mViewportWidth; x++) {
+	for (uint32_t y = 0; y < mRegionSize.y; y++) {
+		for (uint32_t x = 0; x < mRegionSize.x; x++) {
 			glm::vec2 coord = {
-				static_cast<glm::f32>(x) / static_cast<glm::f32>(mViewportWidth),
-				static_cast<glm::f32>(y) / static_cast<glm::f32>(mViewportHeight)
+				static_cast<glm::f32>(mRegionMin.x + x) / static_cast<glm::f32>(mViewportWidth),
+				static_cast<glm::f32>(mRegionMin.y + y) / static_cast<glm::f32>(mViewportHeight)
 			};
 
 			coord = coord * 2.0f - 1.0f; // -1 -> 1
 
 			glm::vec4 target = mInverseProjection * glm::vec4(coord.x, coord.y, 1, 1);
 			glm::vec3 rayDirection = glm::vec3(mInverseView * glm::vec4(glm::normalize(glm::vec3(target) / target.w), 0)); // World space
-			mRayDirections[x + y * mViewportWidth] = rayDirection;
+			mRayDirections[x + static_cast<std::size_t>(y) * mRegionSize.x] = rayDirection;
 		}
 	}
 }
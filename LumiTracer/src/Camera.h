@@ -7,9 +7,17 @@ class Camera {
 public:
 	Camera(glm::f32 verticalFOV, glm::f32 nearClip, glm::f32 farClip);
 
+#ifndef LUX_HEADLESS
 	bool OnUpdate(glm::f32 ts);
+#endif
 	void Resize(glm::u32 width, glm::u32 height);
 
+	// Like Resize(), but only generates rays for pixels in [min, max) of the frame, row 0 at the bottom.
+	// Ray directions and GetRegionSize() then cover just that region.
+	void ResizeRegion(glm::u32 width, glm::u32 height, glm::u32vec2 min, glm::u32vec2 max);
+
+	void SetView(const glm::vec3& position, const glm::vec3& direction);
+
 	[[nodiscard]] const glm::mat4& GetProjection() const { return mProjection; }
 	[[nodiscard]] const glm::mat4& GetInverseProjection() const { return mInverseProjection; }
 	[[nodiscard]] const glm::mat4& GetView() const { return mView; }
@@ -18,7 +26,11 @@ public:
 	[[nodiscard]] const glm::vec3& GetPosition() const { return mPosition; }
 	[[nodiscard]] const glm::vec3& GetDirection() const { return mForwardDirection; }
 
+	[[nodiscard]] glm::f32 GetVerticalFOV() const { return mVerticalFOV; }
+
 	[[nodiscard]] glm::u32vec2 GetViewport() const { return { mViewportWidth, mViewportHeight }; }
+	[[nodiscard]] const glm::u32vec2& GetRegionMin() const { return mRegionMin; }
+	[[nodiscard]] const glm::u32vec2& GetRegionSize() const { return mRegionSize; }
 
 	[[nodiscard]] const std::vector<glm::vec3>& GetRayDirections() const { return mRayDirections; }
 
@@ -49,6 +61,7 @@ private:
 	glm::vec2 mLastMousePosition{ 0.0f, 0.0f };
 
 	glm::u32 mViewportWidth = 0, mViewportHeight = 0;
+	glm::u32vec2 mRegionMin{ 0, 0 }, mRegionSize{ 0, 0 };
 
 	glm::f32 mSensitivity = 0.002f;
 };
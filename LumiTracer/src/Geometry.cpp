@@ -0,0 +1,461 @@
+#include "Geometry.h"
+#include "BVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <limits>
+#include <numeric>
+
+namespace {
+	constexpr glm::u32 FileMagic = 0x4F45474C; // "LGEO"
+	constexpr glm::u32 FileVersion = 1;
+
+	// Spheres streamed per batch while building, ~20 MiB of input at a time.
+	constexpr std::size_t BuildBatchSize = 1 << 20;
+
+	// Upper bound on cells per axis, keeps the per-cell build statistics small. Denser regions are refined
+	// by splitting their cells into octants instead.
+	constexpr glm::u32 MaxGridResolution = 64;
+
+	// Octant splits below a grid cell. A cell still over the chunk size at this depth holds spheres too close
+	// together to separate and is cut into chunks by input order.
+	constexpr glm::u32 MaxSplitDepth = 16;
+
+	struct FileHeader {
+		glm::u32 magic;
+		glm::u32 version;
+		glm::u32 chunkCount;
+		glm::u32 quantized;
+	};
+
+	struct Cell {
+		// Region of space the cell covers, and its first of eight octant children once it has been split
+		glm::vec3 regionMin, regionMax;
+		glm::u32 firstChild = 0;
+		glm::u32 depth = 0;
+
+		std::uint64_t count = 0;
+		glm::vec3 boundsMin{ std::numeric_limits<glm::f32>::max() };
+		glm::vec3 boundsMax{ std::numeric_limits<glm::f32>::lowest() };
+		glm::vec3 centerMin{ std::numeric_limits<glm::f32>::max() };
+		glm::vec3 centerMax{ std::numeric_limits<glm::f32>::lowest() };
+		glm::f32 maxRadius = 0.0f;
+	};
+
+	static std::size_t readBatch(std::ifstream& in, std::vector<Sphere>& batch) {
+		batch.resize(BuildBatchSize);
+		in.read(reinterpret_cast<char*>(batch.data()), BuildBatchSize * sizeof(Sphere));
+		batch.resize(static_cast<std::size_t>(in.gcount()) / sizeof(Sphere));
+		return batch.size();
+	}
+
+	static std::uint16_t quantize(const glm::f32 value, const glm::f32 min, const glm::f32 extent) {
+		if (extent <= 0.0f) {
+			return 0;
+		}
+
+		return static_cast<std::uint16_t>(std::lround(glm::clamp((value - min) / extent, 0.0f, 1.0f) * 65535.0f));
+	}
+
+	static PackedSphere pack(const Sphere& sphere, const GeometryStore::Chunk& chunk) {
+		const glm::vec3 extent = chunk.centerMax - chunk.centerMin;
+
+		return {
+			.position = {
+				quantize(sphere.position.x, chunk.centerMin.x, extent.x),
+				quantize(sphere.position.y, chunk.centerMin.y, extent.y),
+				quantize(sphere.position.z, chunk.centerMin.z, extent.z)
+			},
+			// Round the radius up so quantization never shrinks a sphere. Decoded spheres can then reach past
+			// the exact chunk bounds, Open() pads them by a quantization step to cover that.
+			.radius = static_cast<std::uint16_t>(chunk.maxRadius > 0.0f ? std::min(std::ceil(sphere.radius / chunk.maxRadius * 65535.0f), 65535.0f) : 0.0f),
+			.materialIndex = static_cast<std::uint16_t>(std::clamp(sphere.materialIndex, 0, 65535))
+		};
+	}
+}
+
+GeometryStore::GeometryStore(const std::size_t budgetBytes)
+	: mChunks()
+	, mChunkTree()
+	, mQuantized(false)
+	, mFile()
+	, mFileMutex()
+	, mCacheMutex()
+	, mLRU()
+	, mLookup()
+	, mBudget(budgetBytes)
+	, mResidentBytes(0)
+	, mChunkLoads(0)
+{ }
+
+bool GeometryStore::Build(const std::string& inputPath, const std::string& outputPath, const glm::u32 chunkSize, const bool quantized) {
+	std::ifstream in(inputPath, std::ios::binary);
+	if (!in) {
+		return false;
+	}
+
+	std::vector<Sphere> batch;
+
+	// Pass 1: overall center bounds pick the grid the spheres are bucketed into
+	std::uint64_t total = 0;
+	glm::vec3 sceneMin{ std::numeric_limits<glm::f32>::max() };
+	glm::vec3 sceneMax{ std::numeric_limits<glm::f32>::lowest() };
+
+	while (readBatch(in, batch) > 0) {
+		for (const Sphere& sphere : batch) {
+			sceneMin = glm::min(sceneMin, sphere.position);
+			sceneMax = glm::max(sceneMax, sphere.position);
+		}
+		total += batch.size();
+	}
+
+	if (total == 0) {
+		return false;
+	}
+
+	const glm::f64 targetCells = static_cast<glm::f64>(total) / std::max(chunkSize, 1u);
+	const glm::u32 resolution = std::clamp(static_cast<glm::u32>(std::ceil(std::cbrt(targetCells))), 1u, MaxGridResolution);
+	const glm::vec3 cellScale = static_cast<glm::f32>(resolution) / glm::max(sceneMax - sceneMin, glm::vec3(1e-6f));
+
+	std::vector<Cell> cells(resolution * resolution * resolution);
+	for (glm::u32 z = 0; z < resolution; z++) {
+		for (glm::u32 y = 0; y < resolution; y++) {
+			for (glm::u32 x = 0; x < resolution; x++) {
+				Cell& cell = cells[x + (y + z * resolution) * resolution];
+				cell.regionMin = sceneMin + glm::vec3(glm::u32vec3(x, y, z)) / cellScale;
+				cell.regionMax = sceneMin + glm::vec3(glm::u32vec3(x + 1, y + 1, z + 1)) / cellScale;
+			}
+		}
+	}
+
+	// Grid cell first, then down through the octants of split cells. Child 0 is never a grid cell, so a
+	// firstChild of 0 marks an unsplit cell.
+	auto cellOf = [&](const Sphere& sphere) -> glm::u32 {
+		const glm::vec3 position = (sphere.position - sceneMin) * cellScale;
+		const glm::u32 x = std::min(static_cast<glm::u32>(position.x), resolution - 1);
+		const glm::u32 y = std::min(static_cast<glm::u32>(position.y), resolution - 1);
+		const glm::u32 z = std::min(static_cast<glm::u32>(position.z), resolution - 1);
+
+		glm::u32 index = x + (y + z * resolution) * resolution;
+		while (cells[index].firstChild != 0) {
+			const glm::vec3 middle = (cells[index].regionMin + cells[index].regionMax) * 0.5f;
+			index = cells[index].firstChild
+				+ (sphere.position.x >= middle.x ? 1 : 0) + (sphere.position.y >= middle.y ? 2 : 0) + (sphere.position.z >= middle.z ? 4 : 0);
+		}
+
+		return index;
+	};
+
+	// Pass 2: per-cell counts and bounds. Cells holding more than a chunk are split into octants and only the
+	// new cells are counted again, until every cell fits or can't be split further. Even a tightly clustered
+	// cloud then gives chunks of at most `chunkSize` spheres, each ray only tests that many per chunk.
+	const glm::u32 maxChunk = std::max(chunkSize, 1u);
+
+	for (std::size_t firstNew = 0; firstNew < cells.size();) {
+		in.clear();
+		in.seekg(0);
+		while (readBatch(in, batch) > 0) {
+			for (const Sphere& sphere : batch) {
+				const glm::u32 index = cellOf(sphere);
+				if (index < firstNew) {
+					continue;
+				}
+
+				Cell& stats = cells[index];
+				stats.count++;
+				stats.boundsMin = glm::min(stats.boundsMin, sphere.position - sphere.radius);
+				stats.boundsMax = glm::max(stats.boundsMax, sphere.position + sphere.radius);
+				stats.centerMin = glm::min(stats.centerMin, sphere.position);
+				stats.centerMax = glm::max(stats.centerMax, sphere.position);
+				stats.maxRadius = std::max(stats.maxRadius, sphere.radius);
+			}
+		}
+
+		const std::size_t counted = cells.size();
+		for (std::size_t i = firstNew; i < counted; i++) {
+			if (cells[i].count <= maxChunk || cells[i].depth >= MaxSplitDepth) {
+				continue;
+			}
+
+			const glm::vec3 middle = (cells[i].regionMin + cells[i].regionMax) * 0.5f;
+			cells[i].firstChild = static_cast<glm::u32>(cells.size());
+
+			for (glm::u32 octant = 0; octant < 8; octant++) {
+				Cell child;
+				child.regionMin = glm::vec3(octant & 1 ? middle.x : cells[i].regionMin.x, octant & 2 ? middle.y : cells[i].regionMin.y, octant & 4 ? middle.z : cells[i].regionMin.z);
+				child.regionMax = glm::vec3(octant & 1 ? cells[i].regionMax.x : middle.x, octant & 2 ? cells[i].regionMax.y : middle.y, octant & 4 ? cells[i].regionMax.z : middle.z);
+				child.depth = cells[i].depth + 1;
+				cells.push_back(child);
+			}
+		}
+
+		firstNew = counted;
+	}
+
+	const std::size_t stride = quantized ? sizeof(PackedSphere) : sizeof(Sphere);
+
+	// Every unsplit cell becomes one chunk, or several consecutive ones if it couldn't be split far enough.
+	// Those share the cell's bounds and take its spheres in input order, `maxChunk` at a time.
+	std::vector<Chunk> chunks;
+	std::vector<glm::u32> cellToChunk(cells.size(), std::numeric_limits<glm::u32>::max());
+
+	std::uint64_t firstIndex = 0;
+	for (std::size_t i = 0; i < cells.size(); i++) {
+		if (cells[i].count == 0 || cells[i].firstChild != 0) {
+			continue;
+		}
+
+		cellToChunk[i] = static_cast<glm::u32>(chunks.size());
+
+		for (std::uint64_t first = 0; first < cells[i].count; first += maxChunk) {
+			const glm::u32 count = static_cast<glm::u32>(std::min<std::uint64_t>(cells[i].count - first, maxChunk));
+
+			chunks.push_back({
+				.boundsMin = cells[i].boundsMin,
+				.boundsMax = cells[i].boundsMax,
+				.centerMin = cells[i].centerMin,
+				.centerMax = cells[i].centerMax,
+				.maxRadius = cells[i].maxRadius,
+				.count = count,
+				.firstIndex = firstIndex,
+				.fileOffset = 0
+			});
+			firstIndex += count;
+		}
+
+		// Chunks are addressed with 32-bit indices
+		if (chunks.size() > std::numeric_limits<glm::u32>::max()) {
+			return false;
+		}
+	}
+
+	std::uint64_t offset = sizeof(FileHeader) + chunks.size() * sizeof(Chunk);
+	for (Chunk& chunk : chunks) {
+		chunk.fileOffset = offset;
+		offset += chunk.count * stride;
+	}
+
+	const std::string temporary = outputPath + ".tmp";
+
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+
+		const FileHeader header = {
+			.magic = FileMagic,
+			.version = FileVersion,
+			.chunkCount = static_cast<glm::u32>(chunks.size()),
+			.quantized = quantized
+		};
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(chunks.data()), chunks.size() * sizeof(Chunk));
+
+		// Pass 3: scatter spheres into their chunks, grouping each batch by chunk so writes come in runs
+		std::vector<glm::u32> written(chunks.size(), 0);
+		std::vector<std::uint64_t> placed(cells.size(), 0);
+		std::vector<glm::u32> chunkOf;
+		std::vector<std::size_t> order;
+		std::vector<char> run;
+
+		in.clear();
+		in.seekg(0);
+		while (readBatch(in, batch) > 0) {
+			chunkOf.resize(batch.size());
+			for (std::size_t i = 0; i < batch.size(); i++) {
+				const glm::u32 cell = cellOf(batch[i]);
+				chunkOf[i] = cellToChunk[cell] + static_cast<glm::u32>(placed[cell]++ / maxChunk);
+			}
+
+			order.resize(batch.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [&chunkOf](const std::size_t lhs, const std::size_t rhs) {
+				return chunkOf[lhs] < chunkOf[rhs];
+			});
+
+			for (std::size_t begin = 0; begin < order.size();) {
+				const glm::u32 chunkIndex = chunkOf[order[begin]];
+				const Chunk& chunk = chunks[chunkIndex];
+
+				std::size_t end = begin;
+				run.clear();
+				while (end < order.size() && chunkOf[order[end]] == chunkIndex) {
+					const Sphere& sphere = batch[order[end]];
+
+					if (quantized) {
+						const PackedSphere packed = pack(sphere, chunk);
+						run.insert(run.end(), reinterpret_cast<const char*>(&packed), reinterpret_cast<const char*>(&packed) + sizeof(packed));
+					} else {
+						run.insert(run.end(), reinterpret_cast<const char*>(&sphere), reinterpret_cast<const char*>(&sphere) + sizeof(sphere));
+					}
+
+					end++;
+				}
+
+				out.seekp(chunk.fileOffset + written[chunkIndex] * stride);
+				out.write(run.data(), run.size());
+				written[chunkIndex] += static_cast<glm::u32>(end - begin);
+
+				begin = end;
+			}
+		}
+
+		if (!out) {
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary, outputPath, error);
+
+	return !error;
+}
+
+bool GeometryStore::Export(std::span<const Sphere> spheres, const std::string& path) {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(spheres.data()), spheres.size_bytes());
+	return static_cast<bool>(out);
+}
+
+bool GeometryStore::Open(const std::string& path) {
+	this->Close();
+
+	mFile.open(path, std::ios::binary);
+
+	FileHeader header;
+	mFile.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	if (!mFile || header.magic != FileMagic || header.version != FileVersion) {
+		this->Close();
+		return false;
+	}
+
+	mChunks.resize(header.chunkCount);
+	mFile.read(reinterpret_cast<char*>(mChunks.data()), mChunks.size() * sizeof(Chunk));
+	mQuantized = header.quantized != 0;
+
+	if (!mFile) {
+		this->Close();
+		return false;
+	}
+
+	if (mQuantized) {
+		for (Chunk& chunk : mChunks) {
+			// Rounding error of a quantized center plus the rounded up radius
+			const glm::vec3 padding = (chunk.centerMax - chunk.centerMin + chunk.maxRadius) / 65535.0f;
+			chunk.boundsMin -= padding;
+			chunk.boundsMax += padding;
+		}
+	}
+
+	if (!mChunks.empty()) {
+		std::vector<glm::u32> order(mChunks.size());
+		std::iota(order.begin(), order.end(), 0);
+
+		mChunkTree.reserve(mChunks.size() * 2 - 1);
+		BuildMedianSplitBVH(mChunkTree, order.begin(), order.end(),
+			[this](const glm::u32 chunk) {
+				return (mChunks[chunk].boundsMin + mChunks[chunk].boundsMax) * 0.5f;
+			},
+			[this](const glm::u32 chunk) {
+				return ChunkNode{
+					.boundsMin = mChunks[chunk].boundsMin,
+					.boundsMax = mChunks[chunk].boundsMax,
+					.index = chunk,
+					.leaf = true
+				};
+			},
+			[](const ChunkNode& left, const ChunkNode& right, const glm::u32 rightIndex) {
+				return ChunkNode{
+					.boundsMin = glm::min(left.boundsMin, right.boundsMin),
+					.boundsMax = glm::max(left.boundsMax, right.boundsMax),
+					.index = rightIndex,
+					.leaf = false
+				};
+			});
+	}
+
+	return true;
+}
+
+void GeometryStore::Close() {
+	std::scoped_lock lock(mFileMutex, mCacheMutex);
+
+	mFile.close();
+	mFile.clear();
+	mChunks.clear();
+	mChunkTree.clear();
+	mLRU.clear();
+	mLookup.clear();
+	mResidentBytes = 0;
+}
+
+GeometryStore::ChunkRef GeometryStore::Acquire(const glm::u32 chunk) {
+	{
+		std::scoped_lock lock(mCacheMutex);
+
+		const auto it = mLookup.find(chunk);
+		if (it != mLookup.end()) {
+			mLRU.splice(mLRU.begin(), mLRU, it->second);
+			return it->second->second;
+		}
+	}
+
+	// Read outside of the cache lock so hits on other chunks aren't held up by disk access.
+	ChunkRef resident = this->Load(chunk);
+	if (!resident) {
+		return nullptr;
+	}
+
+	const std::size_t bytes = mChunks[chunk].count * (mQuantized ? sizeof(PackedSphere) : sizeof(Sphere));
+
+	std::scoped_lock lock(mCacheMutex);
+
+	const auto it = mLookup.find(chunk);
+	if (it != mLookup.end()) {
+		return it->second->second;
+	}
+
+	mLRU.emplace_front(chunk, resident);
+	mLookup[chunk] = mLRU.begin();
+	mResidentBytes += bytes;
+
+	while (mResidentBytes > mBudget && mLRU.size() > 1) {
+		const glm::u32 evicted = mLRU.back().first;
+		mResidentBytes -= mChunks[evicted].count * (mQuantized ? sizeof(PackedSphere) : sizeof(Sphere));
+		mLookup.erase(evicted);
+		mLRU.pop_back();
+	}
+
+	return resident;
+}
+
+GeometryStore::ChunkRef GeometryStore::Load(const glm::u32 chunk) {
+	const Chunk& info = mChunks[chunk];
+
+	auto resident = std::make_shared<ResidentChunk>();
+	resident->mCount = info.count;
+
+	std::scoped_lock lock(mFileMutex);
+
+	mFile.seekg(info.fileOffset);
+	if (mQuantized) {
+		resident->mCenterMin = info.centerMin;
+		resident->mCenterScale = (info.centerMax - info.centerMin) / 65535.0f;
+		resident->mRadiusScale = info.maxRadius / 65535.0f;
+		resident->mPacked.resize(info.count);
+		mFile.read(reinterpret_cast<char*>(resident->mPacked.data()), info.count * sizeof(PackedSphere));
+	} else {
+		resident->mSpheres.resize(info.count);
+		mFile.read(reinterpret_cast<char*>(resident->mSpheres.data()), info.count * sizeof(Sphere));
+	}
+
+	if (!mFile) {
+		mFile.clear();
+		return nullptr;
+	}
+
+	mChunkLoads++;
+
+	return resident;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Scene.h"
+
+// Quantized sphere, positions relative to the owning chunk's center bounds. Half the size of a Sphere.
+struct PackedSphere {
+    std::uint16_t position[3];
+    std::uint16_t radius;
+    std::uint16_t materialIndex;
+};
+
+// Sphere geometry that lives on disk (<name>.luxgeo) split into spatially coherent chunks. Chunks are
+// paged in on demand and kept in an LRU cache bounded by a memory budget.
+class GeometryStore {
+public:
+    struct Chunk {
+        glm::vec3 boundsMin, boundsMax;
+        glm::vec3 centerMin, centerMax;
+        glm::f32 maxRadius;
+        glm::u32 count;
+        std::uint64_t firstIndex;
+        std::uint64_t fileOffset;
+    };
+
+    class ResidentChunk {
+    public:
+        [[nodiscard]] glm::u32 GetCount() const { return mCount; }
+
+        [[nodiscard]] Sphere GetSphere(const glm::u32 index) const {
+            if (mPacked.empty()) {
+                return mSpheres[index];
+            }
+
+            const PackedSphere& packed = mPacked[index];
+            const glm::vec3 quantized(packed.position[0], packed.position[1], packed.position[2]);
+
+            return {
+                .position = mCenterMin + quantized * mCenterScale,
+                .radius = static_cast<glm::f32>(packed.radius) * mRadiusScale,
+                .materialIndex = packed.materialIndex
+            };
+        }
+
+    private:
+        friend class GeometryStore;
+
+        glm::u32 mCount = 0;
+        glm::vec3 mCenterMin{ 0.0f };
+        glm::vec3 mCenterScale{ 0.0f };
+        glm::f32 mRadiusScale = 0.0f;
+        std::vector<Sphere> mSpheres;
+        std::vector<PackedSphere> mPacked;
+    };
+
+    using ChunkRef = std::shared_ptr<const ResidentChunk>;
+
+    // Bounding volume hierarchy over the chunk bounds. The left child directly follows its parent, `index`
+    // holds the right child of interior nodes and the chunk of leaves.
+    struct ChunkNode {
+        glm::vec3 boundsMin, boundsMax;
+        glm::u32 index;
+        bool leaf;
+    };
+
+public:
+    explicit GeometryStore(const std::size_t budgetBytes = 1024ull << 20);
+
+    // Partitions a raw array of Sphere records into spatially coherent chunks of at most `chunkSize` spheres.
+    // Streams the input in batches so neither file has to fit in memory.
+    static bool Build(const std::string& inputPath, const std::string& outputPath, const glm::u32 chunkSize, const bool quantized);
+
+    // Writes spheres in the raw layout Build() consumes.
+    static bool Export(std::span<const Sphere> spheres, const std::string& path);
+
+    bool Open(const std::string& path);
+    void Close();
+
+    [[nodiscard]] bool IsOpen() const { return mFile.is_open(); }
+    [[nodiscard]] const std::vector<Chunk>& GetChunks() const { return mChunks; }
+    [[nodiscard]] const std::vector<ChunkNode>& GetChunkTree() const { return mChunkTree; }
+
+    // Returns the chunk's spheres, reading them from disk if they aren't resident.
+    [[nodiscard]] ChunkRef Acquire(const glm::u32 chunk);
+
+    void SetBudget(const std::size_t bytes) { mBudget = bytes; }
+    [[nodiscard]] std::size_t GetBudget() const { return mBudget; }
+    [[nodiscard]] std::size_t GetResidentBytes() const { return mResidentBytes; }
+    [[nodiscard]] std::uint64_t GetChunkLoads() const { return mChunkLoads; }
+
+private:
+    ChunkRef Load(const glm::u32 chunk);
+
+private:
+    std::vector<Chunk> mChunks;
+    std::vector<ChunkNode> mChunkTree;
+    bool mQuantized;
+
+    std::ifstream mFile;
+    std::mutex mFileMutex;
+
+    std::mutex mCacheMutex;
+    std::list<std::pair<glm::u32, ChunkRef>> mLRU;
+    std::unordered_map<glm::u32, std::list<std::pair<glm::u32, ChunkRef>>::iterator> mLookup;
+
+    std::atomic<std::size_t> mBudget;
+    std::atomic<std::size_t> mResidentBytes;
+    std::atomic<std::uint64_t> mChunkLoads;
+};
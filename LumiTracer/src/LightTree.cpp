@@ -0,0 +1,147 @@
+#include "LightTree.h"
+#include "BVH.h"
+#include "Scene.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+	static bool isEmissive(const Scene& scene, const Sphere& sphere) {
+		if (sphere.materialIndex < 0 || sphere.materialIndex >= static_cast<int>(scene.materials.size())) {
+			return false;
+		}
+
+		const Material& material = scene.materials[sphere.materialIndex];
+		return material.emissiveStrength > 0.0f && (material.emissiveColor.r > 0.0f || material.emissiveColor.g > 0.0f || material.emissiveColor.b > 0.0f);
+	}
+
+	// Emitted power up to a constant factor, luminance of the radiance times surface area
+	static glm::f32 emittedPower(const Scene& scene, const Sphere& sphere) {
+		const Material& material = scene.materials[sphere.materialIndex];
+		const glm::vec3 radiance = material.emissiveColor * material.emissiveStrength;
+
+		return glm::dot(radiance, glm::vec3(0.2126f, 0.7152f, 0.0722f)) * sphere.radius * sphere.radius;
+	}
+}
+
+void LightTree::Update(const Scene& scene) {
+	std::vector<glm::u32> lights;
+	for (glm::u32 i = 0; i < scene.spheres.size(); i++) {
+		if (isEmissive(scene, scene.spheres[i])) {
+			lights.push_back(i);
+		}
+	}
+
+	// mLights is in leaf order, compare as sets
+	std::vector<glm::u32> current = mLights;
+	std::sort(current.begin(), current.end());
+
+	if (current == lights && !mNodes.empty()) {
+		this->Refit(scene);
+		return;
+	}
+
+	mNodes.clear();
+	mLights = std::move(lights);
+
+	if (!mLights.empty()) {
+		mNodes.reserve(mLights.size() * 2 - 1);
+		this->Build(scene);
+	}
+}
+
+void LightTree::Build(const Scene& scene) {
+	BuildMedianSplitBVH(mNodes, mLights.begin(), mLights.end(),
+		[&scene](const glm::u32 light) {
+			return scene.spheres[light].position;
+		},
+		[&scene](const glm::u32 light) {
+			const Sphere& sphere = scene.spheres[light];
+
+			return Node{
+				.boundsMin = sphere.position - sphere.radius,
+				.boundsMax = sphere.position + sphere.radius,
+				.power = emittedPower(scene, sphere),
+				.index = light,
+				.leaf = true
+			};
+		},
+		[](const Node& left, const Node& right, const glm::u32 rightIndex) {
+			return Node{
+				.boundsMin = glm::min(left.boundsMin, right.boundsMin),
+				.boundsMax = glm::max(left.boundsMax, right.boundsMax),
+				.power = left.power + right.power,
+				.index = rightIndex,
+				.leaf = false
+			};
+		});
+}
+
+void LightTree::Refit(const Scene& scene) {
+	// Children are stored after their parent, so a reverse sweep visits them first
+	for (glm::u32 i = static_cast<glm::u32>(mNodes.size()); i-- > 0;) {
+		Node& node = mNodes[i];
+
+		if (node.leaf) {
+			const Sphere& sphere = scene.spheres[node.index];
+			node.boundsMin = sphere.position - sphere.radius;
+			node.boundsMax = sphere.position + sphere.radius;
+			node.power = emittedPower(scene, sphere);
+		} else {
+			const Node& left = mNodes[i + 1];
+			const Node& right = mNodes[node.index];
+			node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+			node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+			node.power = left.power + right.power;
+		}
+	}
+}
+
+bool LightTree::Sample(const glm::vec3& position, glm::f32 u, LightSample& sample) const {
+	if (mNodes.empty()) {
+		return false;
+	}
+
+	glm::u32 nodeIndex = 0;
+	glm::f32 probability = 1.0f;
+
+	while (!mNodes[nodeIndex].leaf) {
+		const glm::u32 left = nodeIndex + 1;
+		const glm::u32 right = mNodes[nodeIndex].index;
+
+		const glm::f32 leftImportance = Importance(mNodes[left], position);
+		const glm::f32 rightImportance = Importance(mNodes[right], position);
+		const glm::f32 total = leftImportance + rightImportance;
+
+		const glm::f32 leftProbability = total > 0.0f ? leftImportance / total : 0.5f;
+
+		// Reuse the remainder of `u` for the next level
+		if (u < leftProbability) {
+			u = std::min(u / leftProbability, 0.99999994f);
+			probability *= leftProbability;
+			nodeIndex = left;
+		} else {
+			u = std::min((u - leftProbability) / (1.0f - leftProbability), 0.99999994f);
+			probability *= 1.0f - leftProbability;
+			nodeIndex = right;
+		}
+	}
+
+	sample = {
+		.sphere = mNodes[nodeIndex].index,
+		.probability = probability
+	};
+
+	return probability > 0.0f;
+}
+
+glm::f32 LightTree::Importance(const Node& node, const glm::vec3& position) {
+	const glm::vec3 center = (node.boundsMin + node.boundsMax) * 0.5f;
+	const glm::vec3 extent = node.boundsMax - node.boundsMin;
+	const glm::vec3 offset = position - center;
+
+	// Clamp the distance to the node's size so points inside or near a cluster don't favor it without bound
+	const glm::f32 distance2 = std::max(glm::dot(offset, offset), 0.25f * glm::dot(extent, extent));
+
+	return node.power / distance2;
+}
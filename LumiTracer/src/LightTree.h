@@ -0,0 +1,47 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <vector>
+
+struct Scene;
+
+// Bounding volume hierarchy over the emissive spheres of a scene. Each node stores the combined power of
+// the lights below it, which lets a shading point pick one light in O(log N) with probability roughly
+// proportional to how much it contributes there.
+class LightTree {
+public:
+    struct LightSample {
+        glm::u32 sphere;
+        glm::f32 probability;
+    };
+
+    // Refits bounds and power in place if the same spheres are still emissive, otherwise rebuilds.
+    void Update(const Scene& scene);
+
+    [[nodiscard]] bool IsEmpty() const { return mNodes.empty(); }
+    [[nodiscard]] glm::u32 GetLightCount() const { return static_cast<glm::u32>(mLights.size()); }
+
+    // `u` in [0, 1) picks the light. Returns false if the tree is empty.
+    [[nodiscard]] bool Sample(const glm::vec3& position, glm::f32 u, LightSample& sample) const;
+
+private:
+    struct Node {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        glm::f32 power;
+        // Leaves hold a sphere index, interior nodes the index of their right child. The left child
+        // always directly follows its parent.
+        glm::u32 index;
+        bool leaf;
+    };
+
+    void Build(const Scene& scene);
+    void Refit(const Scene& scene);
+
+    static glm::f32 Importance(const Node& node, const glm::vec3& position);
+
+private:
+    std::vector<Node> mNodes;
+    std::vector<glm::u32> mLights;
+};
@@ -1,10 +1,22 @@
 #include "Renderer.h"
 #include "Camera.h"
+#include "Geometry.h"
+#include "LightTree.h"
+#include "RowPool.h"
 #include "Scene.h"
+#include "Texture.h"
 
-#include "Walnut/Random.h"
+#include "glm/gtc/constants.hpp"
 
 #include <execution>
+#include <cstring>
+#include <new>
+#include <numeric>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace {
 	static glm::u32 convertToRGBA(const glm::vec4& color) {
@@ -16,6 +28,46 @@ namespace {
 		return (a << 24) | (b << 16) | (g << 8) | r;
 	}
 
+	static std::size_t pageSize() {
+#ifdef __linux__
+		return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#else
+		return 4096;
+#endif
+	}
+
+	// Zeroed, page aligned and, on Linux, straight from the kernel. Heap blocks may reuse pages another thread
+	// already faulted in, fresh mappings land wherever they are first written.
+	template<typename T>
+	static T* allocatePages(const std::size_t count) {
+#ifdef __linux__
+		void* data = mmap(nullptr, count * sizeof(T), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (data == MAP_FAILED) {
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(data);
+#else
+		return new T[count]();
+#endif
+	}
+
+	template<typename T>
+	static void freePages(T* data, const std::size_t count) {
+#ifdef __linux__
+		if (data) {
+			munmap(data, count * sizeof(T));
+		}
+#else
+		delete[] data;
+#endif
+	}
+
+	// Smallest number of rows after which both buffers start a new page
+	static glm::u32 rowsPerPage(const glm::u32 width) {
+		const std::size_t page = pageSize();
+		return static_cast<glm::u32>(page / std::gcd(page, width * sizeof(glm::u32)));
+	}
+
 	static glm::u32 hashPCG(const glm::u32 input) {
 		const glm::u32 state = input * 747796405U + 2891336453U, word = ((state >> ((state >> 28U) + 4U)) ^ state) * 277803737U;
 		return (word >> 22U) ^ word;
@@ -34,6 +86,15 @@ namespace {
 		return glm::normalize(randV3(seed, -1.0f, 1.0f));
 	}
 
+	// Density over solid angle of the diffuse bounce normalize(normal + randV3Unit()). randV3Unit() normalizes
+	// a point uniform in a cube, which favours the cube's corners, so this is only roughly cos / pi.
+	static glm::f32 diffusePDF(const glm::vec3& normal, const glm::vec3& direction) {
+		const glm::f32 cosTheta = glm::dot(normal, direction);
+		const glm::vec3 offset = glm::abs(2.0f * cosTheta * direction - normal);
+		const glm::f32 extent = std::max(offset.x, std::max(offset.y, offset.z));
+		return cosTheta / (6.0f * extent * extent * extent);
+	}
+
 	static glm::f32 lerp(const glm::f32 a, const glm::f32 b, const glm::f32 t) {
 		return (1.0f - t) * a + t * b;
 	}
@@ -45,148 +106,397 @@ namespace {
 			lerp(a.z, b.z, t)
 		};
 	}
+
+	// Stands in for material indices the scene doesn't have, e.g. from a .luxgeo built for another scene
+	static const Material FallbackMaterial = {
+		.albedo = glm::vec3(0.8f),
+		.roughness = 1.0f,
+		.metallic = 0.0f,
+		.emissiveColor = glm::vec3(0.0f),
+		.emissiveStrength = 0.0f
+	};
+
+	static glm::f32 intersectSphere(const Ray& ray, const Sphere& sphere) {
+		// (bx^2 + by^2)t^2 + (2(axbx + ayby))t + (ax^2 + ay^2 - r^2) = 0
+		// a = ray origin
+		// b = ray direction
+		// r = radius of sphere
+		// t = hit distance
+
+		glm::vec3 origin = ray.origin - sphere.position;
+
+		glm::f32 a = glm::dot(ray.direction, ray.direction);
+		glm::f32 b = 2.0f * glm::dot(origin, ray.direction);
+		glm::f32 c = glm::dot(origin, origin) - sphere.radius * sphere.radius;
+
+		glm::f32 discriminant = b * b - 4.0f * a * c;
+
+		if (discriminant < 0.0f) {
+			return -1.0f;
+		}
+
+		// (-b +- sqrt(discriminant)) / 2a
+
+		return (-b - glm::sqrt(discriminant)) / (2.0f * a);
+	}
+
+	static bool intersectBounds(const Ray& ray, const glm::vec3& inverseDirection, const glm::vec3& boundsMin, const glm::vec3& boundsMax, glm::f32& entry) {
+		const glm::vec3 t0 = (boundsMin - ray.origin) * inverseDirection;
+		const glm::vec3 t1 = (boundsMax - ray.origin) * inverseDirection;
+		const glm::vec3 tNear = glm::min(t0, t1);
+		const glm::vec3 tFar = glm::max(t0, t1);
+
+		entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		return entry <= std::min(std::min(tFar.x, tFar.y), tFar.z);
+	}
 }
 
 Renderer::Renderer()
 	: mActiveScene(nullptr)
 	, mActiveCamera(nullptr)
-	, mFinalImage()
+	, mTextureCache(nullptr)
+	, mGeometryStore(nullptr)
+	, mActiveGeometry(nullptr)
+	, mLightTree(nullptr)
+	, mActiveLights(nullptr)
+	, mRowPool(nullptr)
+	, mViewport(0, 0)
 	, mFinalImageData(nullptr)
 	, mAccumulationData(nullptr)
+	, mExternalBuffers(false)
+	, mExternalSize(0, 0)
 	, mAccumulationFrames(1)
+	, mPixelSpreadAngle(0.0f)
+	, mCropMin(0, 0)
+	, mCropMax(0, 0)
+	, mCropEnabled(false)
 	, mMaxBounces(1)
 	, mFlags(0)
 { }
 
+Renderer::~Renderer() {
+	this->ReleaseBuffers();
+}
+
 void Renderer::Render(const Scene& scene, const Camera& camera) {
 	mActiveScene = &scene;
 	mActiveCamera = &camera;
+	mActiveGeometry = mGeometryStore && mGeometryStore->IsOpen() ? mGeometryStore : nullptr;
+	mActiveLights = mLightTree && (mFlags & Flags::LightSampling) && !mLightTree->IsEmpty() ? mLightTree : nullptr;
 
-	const glm::u32vec2& viewport = camera.GetViewport();
+	// Buffers only cover the part of the frame the camera generates rays for
+	const glm::u32vec2& viewport = camera.GetRegionSize();
 
 	if (viewport.x == 0 || viewport.y == 0) {
 		return;
 	}
 
-	if (!mFinalImage) {
-		mFinalImage = std::make_unique<Walnut::Image>(viewport.x, viewport.y, Walnut::ImageFormat::RGBA);
-	}
-	
-	if (!mFinalImageData || !mAccumulationData || mFinalImage->GetWidth() != viewport.x || mFinalImage->GetHeight() != viewport.y) {
-		mFinalImage->Resize(viewport.x, viewport.y);
-		delete[] mFinalImageData;
-		mFinalImageData = new glm::u32[viewport.x * viewport.y];
-		delete[] mAccumulationData;
-		mAccumulationData = new glm::vec4[viewport.x * viewport.y];
-
-		mHorizIterBegin = CounterIterator(0);
-		mHorizIterEnd = CounterIterator(viewport.x);
-		mVertIterBegin = CounterIterator(0);
-		mVertIterEnd = CounterIterator(viewport.y);
+	if (mExternalBuffers) {
+		// Never write past memory the caller sized for a different resolution
+		if (viewport.x != mExternalSize.x || viewport.y != mExternalSize.y) {
+			return;
+		}
+
+		if (mViewport.x != viewport.x || mViewport.y != viewport.y) {
+			mViewport = viewport;
+			this->ResetAccumulationFrames();
+		}
+	} else if (!mFinalImageData || !mAccumulationData || mViewport.x != viewport.x || mViewport.y != viewport.y) {
+		// Allocate both before releasing anything so a failure leaves the renderer with its old buffers
+		const std::size_t pixels = static_cast<std::size_t>(viewport.x) * viewport.y;
+		glm::u32* finalImage = allocatePages<glm::u32>(pixels);
+		glm::vec4* accumulation = nullptr;
+		try {
+			accumulation = allocatePages<glm::vec4>(pixels);
+		} catch (...) {
+			freePages(finalImage, pixels);
+			throw;
+		}
+
+		this->ReleaseBuffers();
+		mFinalImageData = finalImage;
+		mAccumulationData = accumulation;
+		mViewport = viewport;
+
+		// First touch happens here. With a RowPool each row is faulted in by a pinned worker of the node that
+		// traces it every frame, keeping its pages on that NUMA node. The standard parallel algorithms have no
+		// fixed row to thread mapping, so without a pool the pages only end up spread across nodes.
+		this->ForEachRow(0, viewport.y, [this, viewport](const glm::u32 y) {
+			std::memset(mFinalImageData + static_cast<std::size_t>(y) * viewport.x, 0, viewport.x * sizeof(glm::u32));
+		});
 
 		this->ResetAccumulationFrames();
 	}
 
-	if (mAccumulationFrames == 1) {
-		std::memset(mAccumulationData, 0, viewport.x * viewport.y * sizeof(glm::vec4));
+	glm::u32vec2 begin(0, 0), end = viewport;
+	if (mCropEnabled) {
+		begin = glm::min(mCropMin, viewport);
+		end = glm::clamp(mCropMax, begin, viewport);
 	}
 
-	std::for_each(std::execution::par, mVertIterBegin, mVertIterEnd, [this, viewport](const glm::u32 y) {
-		std::for_each(mHorizIterBegin, mHorizIterEnd, [this, y, viewport](const glm::u32 x) {
-			glm::vec4 color = this->PerPixel(x, y);
+	mHorizIterBegin = CounterIterator(begin.x);
+	mHorizIterEnd = CounterIterator(end.x);
+	mVertIterBegin = CounterIterator(begin.y);
+	mVertIterEnd = CounterIterator(end.y);
 
-			const glm::u32 pixelIndex = x + y * viewport.x;
+	if (mTextureCache) {
+		mTextureCache->Sync(scene.textures);
+	}
 
-			mAccumulationData[pixelIndex] += color;
+	// Angle subtended by a single pixel, used to grow the ray cone that drives texture filtering
+	mPixelSpreadAngle = 2.0f * glm::tan(glm::radians(camera.GetVerticalFOV()) * 0.5f) / static_cast<glm::f32>(camera.GetViewport().y);
+
+	if (mAccumulationFrames == 1) {
+		this->ForEachRow(0, viewport.y, [this, viewport](const glm::u32 y) {
+			std::memset(mAccumulationData + static_cast<std::size_t>(y) * viewport.x, 0, viewport.x * sizeof(glm::vec4));
+		});
+	}
 
-			glm::vec4 accumulation = mAccumulationData[pixelIndex];
+	this->ForEachRow(*mVertIterBegin, *mVertIterEnd, [this, viewport](const glm::u32 y) {
+		auto accumulate = [this, y, viewport](const glm::u32 x, glm::vec4 color) {
+			const std::size_t pixelIndex = x + static_cast<std::size_t>(y) * viewport.x;
+
+			mAccumulationData[pixelIndex] += color;
 
 			color = glm::clamp(mAccumulationData[pixelIndex] / static_cast<glm::f32>(mAccumulationFrames), { 0.0f }, { 1.0f });
 			mFinalImageData[pixelIndex] = convertToRGBA(color);
-		});
-	});
+		};
 
-	mFinalImage->SetData(mFinalImageData);
+		if (mActiveGeometry) {
+			// Out-of-core geometry is traced a row at a time so each chunk load serves the whole row
+			const std::vector<glm::vec4> colors = this->PerRow(y);
+			std::for_each(mHorizIterBegin, mHorizIterEnd, [&accumulate, &colors, this](const glm::u32 x) {
+				accumulate(x, colors[x - *mHorizIterBegin]);
+			});
+		} else {
+			std::for_each(mHorizIterBegin, mHorizIterEnd, [&accumulate, this, y](const glm::u32 x) {
+				accumulate(x, this->PerPixel(x, y));
+			});
+		}
+	});
 
 	if (mFlags & Flags::Accumulate)
 		mAccumulationFrames++;
 
 	mActiveScene = nullptr;
 	mActiveCamera = nullptr;
+	mActiveGeometry = nullptr;
+	mActiveLights = nullptr;
 }
 
-glm::vec4 Renderer::PerPixel(const glm::u32 x, const glm::u32 y) const {
-	Ray ray = {
-		.origin = mActiveCamera->GetPosition(),
-		.direction = mActiveCamera->GetRayDirections()[x + y * mActiveCamera->GetViewport().x]
-	};
-	
-	glm::u32 seed = (x + y * mActiveCamera->GetViewport().x) * mAccumulationFrames;
+void Renderer::SetOutputBuffers(glm::vec4* accumulation, glm::u32* finalImage, const glm::u32vec2 size) {
+	this->ReleaseBuffers();
 
-	glm::vec3 light = glm::vec3(0.0f);
-	glm::vec3 contribution = glm::vec3(1.0f);
+	mAccumulationData = accumulation;
+	mFinalImageData = finalImage;
+	mExternalBuffers = accumulation && finalImage;
+	mExternalSize = mExternalBuffers ? size : glm::u32vec2(0, 0);
 
-	for (int i = 0; i < mMaxBounces; i++) {
-		seed += i;
+	if (!mExternalBuffers) {
+		mAccumulationData = nullptr;
+		mFinalImageData = nullptr;
+	}
+
+	this->ResetAccumulationFrames();
+}
 
-		Renderer::HitPayload payload = TraceRay(ray);
-		if (payload.hitDistance > 0.0f) {
-			const Sphere& sphere = mActiveScene->spheres[payload.objectIndex];
-			const Material& material = mActiveScene->materials[sphere.materialIndex];
+void Renderer::SetRowPool(RowPool* pool) {
+	if (pool == mRowPool) {
+		return;
+	}
 
-			const glm::vec3 randomAngle = randV3Unit(seed);
-			
-			const glm::vec3 diffuseDir = glm::normalize(payload.worldNormal + randomAngle);
-			const glm::vec3 specularDir = glm::reflect(ray.direction, payload.worldNormal);
+	mRowPool = pool;
 
-			const bool specular = material.metallic >= randF32(seed);
+	this->ReleaseBuffers();
+}
 
-			ray.origin = payload.worldPosition + payload.worldNormal * 0.0001f;
-			ray.direction = lerp(specularDir, diffuseDir, material.roughness * !specular);
+void Renderer::SetCropWindow(const glm::u32vec2 min, const glm::u32vec2 max) {
+	mCropMin = glm::min(min, max);
+	mCropMax = glm::max(min, max);
+	mCropEnabled = true;
 
-			light += material.emissiveColor * material.emissiveStrength * contribution;
-			contribution *= lerp(material.albedo, glm::vec3(1.0f), specular);
-		} else {
+	this->ResetAccumulationFrames();
+}
+
+void Renderer::ClearCropWindow() {
+	mCropEnabled = false;
+
+	this->ResetAccumulationFrames();
+}
+
+void Renderer::ReleaseBuffers() {
+	if (!mExternalBuffers) {
+		const std::size_t pixels = static_cast<std::size_t>(mViewport.x) * mViewport.y;
+		freePages(mFinalImageData, pixels);
+		freePages(mAccumulationData, pixels);
+		mFinalImageData = nullptr;
+		mAccumulationData = nullptr;
+	}
+}
+
+void Renderer::ForEachRow(const glm::u32 begin, const glm::u32 end, const std::function<void(glm::u32)>& perRow) const {
+	if (mRowPool) {
+		mRowPool->Run(begin, end, mViewport.y, rowsPerPage(mViewport.x), perRow);
+	} else {
+		std::for_each(std::execution::par, CounterIterator(begin), CounterIterator(end), perRow);
+	}
+}
+
+glm::vec4 Renderer::PerPixel(const glm::u32 x, const glm::u32 y) const {
+	PathState path = this->BeginPath(x, y);
+
+	for (int i = 0; i < mMaxBounces; i++) {
+		path.seed += i;
+
+		if (!this->Scatter(path, this->TraceRay(path.ray))) {
 			break;
 		}
+
+		if (path.shadowPending) {
+			path.light += this->ResolveDirectLight(path.shadow, this->TraceRay(path.shadow.ray));
+		}
 	}
 
-	return glm::vec4(light, 1.0f);
+	return glm::vec4(path.light, 1.0f);
 }
 
-Renderer::HitPayload Renderer::TraceRay(const Ray& ray) const {
-	// (bx^2 + by^2)t^2 + (2(axbx + ayby))t + (ax^2 + ay^2 - r^2) = 0
-	// a = ray origin
-	// b = ray direction
-	// r = radius of sphere
-	// t = hit distance
+std::vector<glm::vec4> Renderer::PerRow(const glm::u32 y) const {
+	std::vector<PathState> paths;
+	std::vector<glm::u32> active;
 
-	constexpr glm::vec4 clearColor = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	std::for_each(mHorizIterBegin, mHorizIterEnd, [this, y, &paths, &active](const glm::u32 x) {
+		active.push_back(static_cast<glm::u32>(paths.size()));
+		paths.push_back(this->BeginPath(x, y));
+	});
 
-	if (mActiveScene->spheres.size() == 0) [[unlikely]] {
-		return this->Miss();
-	}
+	std::vector<Ray> rays;
+	std::vector<HitPayload> payloads;
+	std::vector<glm::u32> shadowPaths;
 
-	glm::u32 objectIndex = std::numeric_limits<glm::u32>::max();
-	glm::f32 hitDistance = std::numeric_limits<glm::f32>::max();
-	for (int i = 0; i < mActiveScene->spheres.size(); i++) {
-		const auto& sphere = mActiveScene->spheres[i];
+	// Bounce the whole row in lockstep so every bounce is one batch of rays for TraceRays
+	for (int i = 0; i < mMaxBounces && !active.empty(); i++) {
+		rays.clear();
+		for (const glm::u32 index : active) {
+			paths[index].seed += i;
+			rays.push_back(paths[index].ray);
+		}
 
-		glm::vec3 origin = ray.origin - sphere.position;
+		payloads.resize(rays.size());
+		this->TraceRays(rays, payloads);
 
-		glm::f32 a = glm::dot(ray.direction, ray.direction);
-		glm::f32 b = 2.0f * glm::dot(origin, ray.direction);
-		glm::f32 c = glm::dot(origin, origin) - sphere.radius * sphere.radius;
+		std::size_t kept = 0;
+		for (std::size_t j = 0; j < active.size(); j++) {
+			if (this->Scatter(paths[active[j]], payloads[j])) {
+				active[kept++] = active[j];
+			}
+		}
+		active.resize(kept);
+
+		// Shadow rays of the bounce go out as one more batch
+		rays.clear();
+		shadowPaths.clear();
+		for (const glm::u32 index : active) {
+			if (paths[index].shadowPending) {
+				shadowPaths.push_back(index);
+				rays.push_back(paths[index].shadow.ray);
+			}
+		}
 
-		glm::f32 discriminant = b * b - 4.0f * a * c;
+		payloads.resize(rays.size());
+		this->TraceRays(rays, payloads);
 
-		if (discriminant < 0.0f) {
-			continue;
+		for (std::size_t j = 0; j < shadowPaths.size(); j++) {
+			PathState& path = paths[shadowPaths[j]];
+			path.light += this->ResolveDirectLight(path.shadow, payloads[j]);
 		}
+	}
 
-		// (-b +- sqrt(discriminant)) / 2a
+	std::vector<glm::vec4> colors(paths.size());
+	for (std::size_t i = 0; i < paths.size(); i++) {
+		colors[i] = glm::vec4(paths[i].light, 1.0f);
+	}
+
+	return colors;
+}
+
+Renderer::PathState Renderer::BeginPath(const glm::u32 x, const glm::u32 y) const {
+	// Seeded by the position in the whole frame, so a region renders exactly like that part of the frame
+	const glm::u32vec2 pixel = mActiveCamera->GetRegionMin() + glm::u32vec2(x, y);
+
+	return {
+		.ray = {
+			.origin = mActiveCamera->GetPosition(),
+			.direction = mActiveCamera->GetRayDirections()[x + static_cast<std::size_t>(y) * mActiveCamera->GetRegionSize().x]
+		},
+		.light = glm::vec3(0.0f),
+		.contribution = glm::vec3(1.0f),
+		.pathLength = 0.0f,
+		.emissionWeight = 1.0f,
+		.seed = (pixel.x + pixel.y * mActiveCamera->GetViewport().x) * mAccumulationFrames,
+		.shadow = {},
+		.shadowPending = false
+	};
+}
 
-		glm::f32 t1 = (-b - glm::sqrt(discriminant)) / (2.0f * a);
+bool Renderer::Scatter(PathState& path, const HitPayload& payload) const {
+	if (payload.hitDistance <= 0.0f) {
+		return false;
+	}
+
+	const bool validMaterial = payload.materialIndex >= 0 && payload.materialIndex < static_cast<int>(mActiveScene->materials.size());
+	const Material& material = validMaterial ? mActiveScene->materials[payload.materialIndex] : FallbackMaterial;
+
+	path.pathLength += payload.hitDistance * glm::length(path.ray.direction);
+	const SurfaceSample surface = this->SampleMaterial(material, payload, path.ray.direction, path.pathLength * mPixelSpreadAngle);
+
+	const glm::vec3 randomAngle = randV3Unit(path.seed);
+	
+	const glm::vec3 diffuseDir = glm::normalize(payload.worldNormal + randomAngle);
+	const glm::vec3 specularDir = glm::reflect(path.ray.direction, payload.worldNormal);
+
+	const bool specular = surface.metallic >= randF32(path.seed);
+
+	// Only in-core emitters are in the light tree. Emission found any other way wasn't sampled directly.
+	const bool sampledEmitter = payload.objectIndex < mActiveScene->spheres.size();
+	path.light += surface.emission * path.contribution * (sampledEmitter ? path.emissionWeight : 1.0f);
+
+	// Light sampling needs the density of the bounce direction, which is only known while the blended lobe
+	// is purely diffuse. Such a bounce gathers light directly from a sampled emitter, so the emitter its ray
+	// hits next doesn't add its emission a second time. Every other bounce counts emission as found.
+	const bool sampleLights = mActiveLights && !specular && surface.roughness >= 1.0f;
+
+	path.shadowPending = false;
+	if (sampleLights) {
+		path.shadowPending = this->SampleDirectLight(payload, path.pathLength * mPixelSpreadAngle, path.seed, path.shadow);
+		path.shadow.weight *= surface.albedo * path.contribution;
+		path.emissionWeight = 0.0f;
+	} else {
+		path.emissionWeight = 1.0f;
+	}
+
+	path.ray.origin = payload.worldPosition + payload.worldNormal * 0.0001f;
+	path.ray.direction = lerp(specularDir, diffuseDir, surface.roughness * !specular);
+
+	path.contribution *= lerp(surface.albedo, glm::vec3(1.0f), specular);
+
+	return true;
+}
+
+Renderer::HitPayload Renderer::TraceRay(const Ray& ray) const {
+	if (mActiveGeometry) {
+		HitPayload payload;
+		this->TraceRays({ &ray, 1 }, { &payload, 1 });
+		return payload;
+	}
+
+	if (mActiveScene->spheres.size() == 0) [[unlikely]] {
+		return this->Miss();
+	}
+
+	std::uint64_t objectIndex = std::numeric_limits<std::uint64_t>::max();
+	glm::f32 hitDistance = std::numeric_limits<glm::f32>::max();
+	for (std::size_t i = 0; i < mActiveScene->spheres.size(); i++) {
+		glm::f32 t1 = intersectSphere(ray, mActiveScene->spheres[i]);
 
 		if (t1 > 0.0f && t1 < hitDistance) {
 			objectIndex = i;
@@ -194,16 +504,134 @@ Renderer::HitPayload Renderer::TraceRay(const Ray& ray) const {
 		}
 	}
 
-	if (objectIndex == std::numeric_limits<glm::u32>::max()) {
+	if (objectIndex == std::numeric_limits<std::uint64_t>::max()) {
 		return this->Miss();
 	} else {
-		return this->ClosestHit(ray, hitDistance, objectIndex);
+		return this->ClosestHit(ray, hitDistance, mActiveScene->spheres[objectIndex], objectIndex);
 	}
 }
 
-Renderer::HitPayload Renderer::ClosestHit(const Ray& ray, const glm::f32 hitDistance, const glm::u32 objectIndex) const {
-	const auto& sphere = mActiveScene->spheres[objectIndex];
+void Renderer::TraceRays(std::span<const Ray> rays, std::span<HitPayload> payloads) const {
+	struct QueueEntry {
+		glm::u32 chunk;
+		glm::u32 ray;
+		glm::f32 entry;
+	};
+
+	struct ChunkQueue {
+		std::size_t begin, end;
+		glm::f32 nearest;
+	};
+
+	std::vector<glm::f32> hitDistance(rays.size(), std::numeric_limits<glm::f32>::max());
+	std::vector<std::uint64_t> objectIndex(rays.size(), std::numeric_limits<std::uint64_t>::max());
+	std::vector<Sphere> hitSphere(rays.size());
+
+	// In-core spheres first, their hits let the chunk pass skip everything behind them
+	for (glm::u32 r = 0; r < rays.size(); r++) {
+		for (glm::u32 i = 0; i < mActiveScene->spheres.size(); i++) {
+			const glm::f32 t = intersectSphere(rays[r], mActiveScene->spheres[i]);
+
+			if (t > 0.0f && t < hitDistance[r]) {
+				hitDistance[r] = t;
+				objectIndex[r] = i;
+				hitSphere[r] = mActiveScene->spheres[i];
+			}
+		}
+	}
+
+	// Queue every ray on each chunk whose bounds it crosses, found through the hierarchy over chunk bounds
+	const std::vector<GeometryStore::Chunk>& chunks = mActiveGeometry->GetChunks();
+	const std::vector<GeometryStore::ChunkNode>& tree = mActiveGeometry->GetChunkTree();
+
+	std::vector<QueueEntry> entries;
+	std::vector<glm::u32> stack;
+	for (glm::u32 r = 0; r < rays.size() && !tree.empty(); r++) {
+		const glm::vec3 inverseDirection = 1.0f / rays[r].direction;
+
+		stack.assign(1, 0);
+		while (!stack.empty()) {
+			const glm::u32 nodeIndex = stack.back();
+			const GeometryStore::ChunkNode& node = tree[nodeIndex];
+			stack.pop_back();
+
+			glm::f32 entry;
+			if (!intersectBounds(rays[r], inverseDirection, node.boundsMin, node.boundsMax, entry) || entry >= hitDistance[r]) {
+				continue;
+			}
+
+			if (node.leaf) {
+				entries.push_back({ .chunk = node.index, .ray = r, .entry = entry });
+			} else {
+				stack.push_back(node.index);
+				stack.push_back(nodeIndex + 1);
+			}
+		}
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const QueueEntry& lhs, const QueueEntry& rhs) {
+		return lhs.chunk < rhs.chunk;
+	});
+
+	std::vector<ChunkQueue> queues;
+	for (std::size_t i = 0; i < entries.size(); i++) {
+		if (queues.empty() || entries[queues.back().begin].chunk != entries[i].chunk) {
+			queues.push_back({ .begin = i, .end = i, .nearest = entries[i].entry });
+		}
+
+		queues.back().end = i + 1;
+		queues.back().nearest = std::min(queues.back().nearest, entries[i].entry);
+	}
+
+	// Visit chunks front to back so closer hits cull rays out of the farther queues before they load
+	std::sort(queues.begin(), queues.end(), [](const ChunkQueue& lhs, const ChunkQueue& rhs) {
+		return lhs.nearest < rhs.nearest;
+	});
 
+	for (const ChunkQueue& queue : queues) {
+		const bool needed = std::any_of(entries.begin() + queue.begin, entries.begin() + queue.end, [&hitDistance](const QueueEntry& entry) {
+			return entry.entry < hitDistance[entry.ray];
+		});
+
+		if (!needed) {
+			continue;
+		}
+
+		const glm::u32 chunkIndex = entries[queue.begin].chunk;
+		const GeometryStore::ChunkRef chunk = mActiveGeometry->Acquire(chunkIndex);
+		if (!chunk) [[unlikely]] {
+			continue;
+		}
+
+		for (std::size_t e = queue.begin; e < queue.end; e++) {
+			const glm::u32 r = entries[e].ray;
+			if (entries[e].entry >= hitDistance[r]) {
+				continue;
+			}
+
+			for (glm::u32 i = 0; i < chunk->GetCount(); i++) {
+				const Sphere sphere = chunk->GetSphere(i);
+				const glm::f32 t = intersectSphere(rays[r], sphere);
+
+				if (t > 0.0f && t < hitDistance[r]) {
+					hitDistance[r] = t;
+					objectIndex[r] = mActiveScene->spheres.size() + chunks[chunkIndex].firstIndex + i;
+					hitSphere[r] = sphere;
+				}
+			}
+		}
+	}
+
+	for (glm::u32 r = 0; r < rays.size(); r++) {
+		if (objectIndex[r] == std::numeric_limits<std::uint64_t>::max()) {
+			payloads[r] = this->Miss();
+		} else {
+			payloads[r] = this->ClosestHit(rays[r], hitDistance[r], hitSphere[r], objectIndex[r]);
+		}
+	}
+}
+
+Renderer::HitPayload Renderer::ClosestHit(const Ray& ray, const glm::f32 hitDistance, const Sphere& sphere, const std::uint64_t objectIndex) const {
 	glm::vec3 origin = ray.origin - sphere.position;
 
 	glm::vec3 worldPosition = origin + ray.direction * hitDistance;
@@ -214,6 +642,8 @@ Renderer::HitPayload Renderer::ClosestHit(const Ray& ray, const glm::f32 hitDist
 		.worldPosition = sphere.position + worldPosition,
 		.worldNormal = normal,
 		.objectIndex = objectIndex,
+		.radius = sphere.radius,
+		.materialIndex = sphere.materialIndex
 	};
 }
 
@@ -222,3 +652,103 @@ Renderer::HitPayload Renderer::Miss() const {
 		.hitDistance = -1.0f
 	};
 }
+
+bool Renderer::SampleDirectLight(const HitPayload& payload, const glm::f32 coneWidth, glm::u32& seed, ShadowQuery& query) const {
+	LightTree::LightSample sample;
+	if (!mActiveLights->Sample(payload.worldPosition, randF32(seed), sample)) {
+		return false;
+	}
+
+	const Sphere& light = mActiveScene->spheres[sample.sphere];
+
+	const glm::vec3 toLight = light.position - payload.worldPosition;
+	const glm::f32 distance2 = glm::dot(toLight, toLight);
+	if (distance2 <= light.radius * light.radius) {
+		return false;
+	}
+
+	// Uniformly sample the cone of directions the sphere subtends
+	const glm::f32 cosThetaMax = glm::sqrt(std::max(0.0f, 1.0f - light.radius * light.radius / distance2));
+	const glm::f32 cosTheta = 1.0f - randF32(seed) * (1.0f - cosThetaMax);
+	const glm::f32 sinTheta = glm::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+	const glm::f32 phi = glm::two_pi<glm::f32>() * randF32(seed);
+
+	const glm::vec3 w = toLight / glm::sqrt(distance2);
+	const glm::vec3 u = glm::normalize(glm::cross(glm::abs(w.x) > 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f), w));
+	const glm::vec3 v = glm::cross(w, u);
+	const glm::vec3 direction = u * (glm::cos(phi) * sinTheta) + v * (glm::sin(phi) * sinTheta) + w * cosTheta;
+
+	const glm::f32 cosSurface = glm::dot(payload.worldNormal, direction);
+	if (cosSurface <= 0.0f) {
+		return false;
+	}
+
+	// BRDF of the diffuse bounce over the pdf of picking this light and then this direction. The bounce
+	// weights its rays by the albedo alone, so its BRDF times the cosine is albedo * diffusePDF().
+	const glm::f32 solidAngle = glm::two_pi<glm::f32>() * (1.0f - cosThetaMax);
+
+	query = {
+		.ray = {
+			.origin = payload.worldPosition + payload.worldNormal * 0.0001f,
+			.direction = direction
+		},
+		.weight = glm::vec3(diffusePDF(payload.worldNormal, direction) * solidAngle / sample.probability),
+		.coneWidth = coneWidth,
+		.light = sample.sphere
+	};
+
+	return true;
+}
+
+glm::vec3 Renderer::ResolveDirectLight(const ShadowQuery& query, const HitPayload& shadow) const {
+	if (shadow.hitDistance <= 0.0f || shadow.objectIndex != query.light) {
+		return glm::vec3(0.0f);
+	}
+
+	const Material& material = mActiveScene->materials[mActiveScene->spheres[query.light].materialIndex];
+	const glm::f32 coneWidth = query.coneWidth + shadow.hitDistance * mPixelSpreadAngle;
+
+	return this->SampleMaterial(material, shadow, query.ray.direction, coneWidth).emission * query.weight;
+}
+
+Renderer::SurfaceSample Renderer::SampleMaterial(const Material& material, const HitPayload& payload, const glm::vec3& direction, const glm::f32 coneWidth) const {
+	SurfaceSample surface = {
+		.albedo = material.albedo,
+		.roughness = material.roughness,
+		.metallic = material.metallic,
+		.emission = material.emissiveColor * material.emissiveStrength
+	};
+
+	if (!mTextureCache) {
+		return surface;
+	}
+
+	const glm::vec3& normal = payload.worldNormal;
+
+	const glm::vec2 uv = {
+		0.5f + glm::atan(normal.z, normal.x) / glm::two_pi<glm::f32>(),
+		0.5f - glm::asin(glm::clamp(normal.y, -1.0f, 1.0f)) / glm::pi<glm::f32>()
+	};
+
+	// Project the ray cone onto the surface and express its width in uv units along the equator
+	const glm::f32 cosine = std::max(glm::abs(glm::dot(glm::normalize(direction), normal)), 0.1f);
+	const glm::f32 footprint = coneWidth / (cosine * glm::two_pi<glm::f32>() * payload.radius);
+
+	if (material.albedoTexture >= 0) {
+		surface.albedo *= glm::vec3(mTextureCache->Sample(material.albedoTexture, uv, footprint));
+	}
+
+	if (material.roughnessTexture >= 0) {
+		surface.roughness *= mTextureCache->Sample(material.roughnessTexture, uv, footprint).r;
+	}
+
+	if (material.metallicTexture >= 0) {
+		surface.metallic *= mTextureCache->Sample(material.metallicTexture, uv, footprint).r;
+	}
+
+	if (material.emissiveTexture >= 0) {
+		surface.emission *= glm::vec3(mTextureCache->Sample(material.emissiveTexture, uv, footprint));
+	}
+
+	return surface;
+}
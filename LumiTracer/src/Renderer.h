@@ -1,21 +1,30 @@
 #pragma once
 
-#include "Walnut/Image.h"
 #include "glm/glm.hpp"
 
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <span>
 #include <vector>
 
 #include "Ray.h"
 #include "CounterIterator.h"
 
 class Camera;
+class GeometryStore;
+class LightTree;
+class RowPool;
+class TextureCache;
+struct Material;
 struct Scene;
+struct Sphere;
 
 class Renderer {
 public:
     enum class Flags {
-        Accumulate = 1 << 0
+        Accumulate = 1 << 0,
+        LightSampling = 1 << 1
     };
 
     friend glm::u32 operator&(const glm::u32 lhs, const Flags rhs) {
@@ -32,16 +41,48 @@ public:
 
 public:
     Renderer();
+    ~Renderer();
+
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
 
     void Render(const Scene& scene, const Camera& camera);
 
-    [[nodiscard]] Walnut::Image* GetFinalImage() { return mFinalImage.get(); }
+    // RGBA8 pixels of the last frame, bottom row first. Sized to GetViewport(), the camera's region size.
+    [[nodiscard]] const glm::u32* GetFinalImageData() const { return mFinalImageData; }
+    [[nodiscard]] glm::u32vec2 GetViewport() const { return mViewport; }
+
+    // Running sum of every frame since accumulation was reset, divide by GetAccumulationFrames() - 1.
+    [[nodiscard]] const glm::vec4* GetAccumulationData() const { return mAccumulationData; }
+
+    // Renders into caller-owned buffers of `size` pixels instead of allocating its own. They must stay valid
+    // until replaced, passing nullptr for both goes back to internal buffers. Frames are skipped while the
+    // camera's region doesn't match `size`.
+    void SetOutputBuffers(glm::vec4* accumulation, glm::u32* finalImage, const glm::u32vec2 size);
 
     void ResetAccumulationFrames() { mAccumulationFrames = 1; }
     [[nodiscard]] glm::u32 GetAccumulationFrames() const { return mAccumulationFrames; }
 
     void SetMaxBounces(const int count) { mMaxBounces = count; }
 
+    // Only pixels in [min, max) are traced and accumulated, the rest of the image keeps its last value.
+    // Coordinates are in image pixels with row 0 at the bottom. Changing the window restarts accumulation.
+    void SetCropWindow(const glm::u32vec2 min, const glm::u32vec2 max);
+    void ClearCropWindow();
+    [[nodiscard]] bool HasCropWindow() const { return mCropEnabled; }
+
+    void SetTextureCache(TextureCache* cache) { mTextureCache = cache; }
+
+    // Traces the store's chunks in addition to Scene::spheres while it is open.
+    void SetGeometryStore(GeometryStore* store) { mGeometryStore = store; }
+
+    // Emitters for next event estimation, used while Flags::LightSampling is set.
+    void SetLightTree(const LightTree* tree) { mLightTree = tree; }
+
+    // Traces rows on the pool's pinned workers instead of the standard parallel algorithms. Internal
+    // buffers are faulted in again on the next frame so their pages follow the pool's row partitioning.
+    void SetRowPool(RowPool* pool);
+
     [[nodiscard]] glm::u32& GetFlags() { return mFlags; }
 
 private:
@@ -49,25 +90,83 @@ private:
         glm::f32 hitDistance;
         glm::vec3 worldPosition;
         glm::vec3 worldNormal;
-        glm::u32 objectIndex;
+        // In-core spheres come first, out-of-core spheres follow at Scene::spheres.size() + their file index
+        std::uint64_t objectIndex;
+        glm::f32 radius;
+        int materialIndex;
+    };
+
+    // Direct light sample whose visibility is still to be traced
+    struct ShadowQuery {
+        Ray ray;
+        glm::vec3 weight;
+        glm::f32 coneWidth;
+        glm::u32 light;
     };
 
+    struct PathState {
+        Ray ray;
+        glm::vec3 light;
+        glm::vec3 contribution;
+        glm::f32 pathLength;
+        // Share of emission from the next hit that light sampling hasn't already accounted for
+        glm::f32 emissionWeight;
+        glm::u32 seed;
+        ShadowQuery shadow;
+        bool shadowPending;
+    };
+
+    struct SurfaceSample {
+        glm::vec3 albedo;
+        glm::f32 roughness;
+        glm::f32 metallic;
+        glm::vec3 emission;
+    };
+
+    // Frees internal buffers, leaves caller-owned ones alone
+    void ReleaseBuffers();
+
+    void ForEachRow(const glm::u32 begin, const glm::u32 end, const std::function<void(glm::u32)>& perRow) const;
+
     glm::vec4 PerPixel(const glm::u32 x, const glm::u32 y) const;
+    std::vector<glm::vec4> PerRow(const glm::u32 y) const;
+
+    PathState BeginPath(const glm::u32 x, const glm::u32 y) const;
+    bool Scatter(PathState& path, const HitPayload& payload) const;
 
     HitPayload TraceRay(const Ray& ray) const;
+    void TraceRays(std::span<const Ray> rays, std::span<HitPayload> payloads) const;
 
-    HitPayload ClosestHit(const Ray& ray, const glm::f32 hitDistance, const glm::u32 objectIndex) const;
+    HitPayload ClosestHit(const Ray& ray, const glm::f32 hitDistance, const Sphere& sphere, const std::uint64_t objectIndex) const;
     HitPayload Miss() const;
 
+    // Picks a light and a direction towards it. Returns false if the sample can't contribute, otherwise
+    // the shadow ray in `query` has to be traced and passed to ResolveDirectLight.
+    bool SampleDirectLight(const HitPayload& payload, const glm::f32 coneWidth, glm::u32& seed, ShadowQuery& query) const;
+    glm::vec3 ResolveDirectLight(const ShadowQuery& query, const HitPayload& shadow) const;
+
+    SurfaceSample SampleMaterial(const Material& material, const HitPayload& payload, const glm::vec3& direction, const glm::f32 coneWidth) const;
+
 private:
     const Scene* mActiveScene;
     const Camera* mActiveCamera;
-    std::unique_ptr<Walnut::Image> mFinalImage;
+    TextureCache* mTextureCache;
+    GeometryStore* mGeometryStore;
+    GeometryStore* mActiveGeometry;
+    const LightTree* mLightTree;
+    const LightTree* mActiveLights;
+    RowPool* mRowPool;
+    glm::u32vec2 mViewport;
     glm::u32* mFinalImageData;
     glm::vec4* mAccumulationData;
+    bool mExternalBuffers;
+    glm::u32vec2 mExternalSize;
     glm::u32 mAccumulationFrames;
+    glm::f32 mPixelSpreadAngle;
     CounterIterator mHorizIterBegin, mHorizIterEnd;
     CounterIterator mVertIterBegin, mVertIterEnd;
+    glm::u32vec2 mCropMin, mCropMax;
+    bool mCropEnabled;
     int mMaxBounces;
     glm::u32 mFlags;
 };
@@ -0,0 +1,222 @@
+#include "RowPool.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+	// CPUs this process may run on, empty if they can't be queried
+	static std::vector<int> allowedCPUs() {
+		std::vector<int> cpus;
+
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+
+		if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+			for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+				if (CPU_ISSET(cpu, &set)) {
+					cpus.push_back(cpu);
+				}
+			}
+		}
+#endif
+
+		return cpus;
+	}
+
+	// NUMA node of every CPU, indexed by CPU. Empty where the kernel doesn't export the topology.
+	static std::vector<int> cpuNodes() {
+		std::vector<int> nodes;
+
+#ifdef __linux__
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error)) {
+			const std::string name = entry.path().filename().string();
+			if (name.size() <= 4 || name.compare(0, 4, "node") != 0 || name.find_first_not_of("0123456789", 4) != std::string::npos) {
+				continue;
+			}
+
+			// Comma separated ranges like "0-3,8-11"
+			std::ifstream file(entry.path() / "cpulist");
+			std::string range;
+			while (std::getline(file, range, ',')) {
+				int first = 0, last = 0;
+				std::istringstream stream(range);
+				if (!(stream >> first)) {
+					continue;
+				}
+				if (!(stream.get() == '-' && stream >> last)) {
+					last = first;
+				}
+
+				for (int cpu = first; cpu <= last; cpu++) {
+					if (cpu >= static_cast<int>(nodes.size())) {
+						nodes.resize(cpu + 1, 0);
+					}
+					nodes[cpu] = std::stoi(name.substr(4));
+				}
+			}
+		}
+#endif
+
+		return nodes;
+	}
+}
+
+RowPool::RowPool()
+	: mRunMutex()
+	, mMutex()
+	, mWakeup()
+	, mDone()
+	, mJob(nullptr)
+	, mBegin(0)
+	, mEnd(0)
+	, mRows(0)
+	, mRowsPerPage(1)
+	, mGeneration(0)
+	, mPending(0)
+	, mStopping(false)
+	, mError()
+	, mSize(0)
+	, mNodes()
+	, mSlots()
+	, mWorkers()
+{
+	std::vector<int> cpus = allowedCPUs();
+	const std::vector<int> nodes = cpuNodes();
+
+	auto nodeOf = [&nodes](const int cpu) { return cpu < static_cast<int>(nodes.size()) ? nodes[cpu] : 0; };
+
+	// Workers of one node sit next to each other, so consecutive workers can share a contiguous block of rows
+	std::stable_sort(cpus.begin(), cpus.end(), [&nodeOf](const int lhs, const int rhs) { return nodeOf(lhs) < nodeOf(rhs); });
+
+	mSize = cpus.empty() ? std::max(std::thread::hardware_concurrency(), 1u) : static_cast<glm::u32>(cpus.size());
+
+	for (glm::u32 i = 0; i < mSize; i++) {
+		if (i == 0 || (!cpus.empty() && nodeOf(cpus[i]) != nodeOf(cpus[i - 1]))) {
+			mNodes.push_back({ .firstWorker = i, .workerCount = 0 });
+		}
+		mSlots.push_back({ .node = static_cast<glm::u32>(mNodes.size() - 1), .rank = mNodes.back().workerCount++ });
+	}
+
+	for (glm::u32 i = 0; i < mSize; i++) {
+		mWorkers.emplace_back(&RowPool::WorkerLoop, this, i);
+
+#ifdef __linux__
+		if (!cpus.empty()) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpus[i], &set);
+
+			// Best effort, an unpinned worker still gets the same rows every frame
+			pthread_setaffinity_np(mWorkers.back().native_handle(), sizeof(set), &set);
+		}
+#endif
+	}
+}
+
+RowPool::~RowPool() {
+	{
+		std::scoped_lock lock(mMutex);
+		mStopping = true;
+	}
+	mWakeup.notify_all();
+
+	for (std::thread& worker : mWorkers) {
+		worker.join();
+	}
+}
+
+void RowPool::Run(const glm::u32 begin, const glm::u32 end, const glm::u32 rows, const glm::u32 rowsPerPage,
+	const std::function<void(glm::u32)>& perRow) {
+	if (begin >= end) {
+		return;
+	}
+
+	std::scoped_lock run(mRunMutex);
+
+	std::unique_lock lock(mMutex);
+	mJob = &perRow;
+	mBegin = begin;
+	mEnd = end;
+	mRows = std::max(rows, end);
+	mRowsPerPage = std::max(rowsPerPage, 1u);
+	mPending = mSize;
+	mGeneration++;
+
+	lock.unlock();
+	mWakeup.notify_all();
+	lock.lock();
+
+	mDone.wait(lock, [this]() { return mPending == 0; });
+	mJob = nullptr;
+
+	if (mError) {
+		std::rethrow_exception(std::exchange(mError, nullptr));
+	}
+}
+
+void RowPool::WorkerLoop(const glm::u32 worker) {
+	std::uint64_t generation = 0;
+
+	while (true) {
+		const std::function<void(glm::u32)>* job;
+		glm::u32 begin, end, rows, rowsPerPage;
+
+		{
+			std::unique_lock lock(mMutex);
+			mWakeup.wait(lock, [this, generation]() { return mStopping || mGeneration != generation; });
+
+			if (mStopping) {
+				return;
+			}
+
+			generation = mGeneration;
+			job = mJob;
+			begin = mBegin;
+			end = mEnd;
+			rows = mRows;
+			rowsPerPage = mRowsPerPage;
+		}
+
+		// The node's block covers its share of the workers, rounded to whole pages
+		const Node& node = mNodes[mSlots[worker].node];
+		const std::uint64_t pages = (static_cast<std::uint64_t>(rows) + rowsPerPage - 1) / rowsPerPage;
+		auto blockStart = [&](const glm::u32 firstWorker) {
+			return static_cast<glm::u32>(std::min<std::uint64_t>(pages * firstWorker / mSize * rowsPerPage, rows));
+		};
+		const glm::u32 first = blockStart(node.firstWorker);
+		const glm::u32 last = std::min(blockStart(node.firstWorker + node.workerCount), end);
+		const glm::u32 start = std::max(first, begin);
+
+		// An exception escaping a worker would terminate the process, Run() rethrows the first one instead
+		std::exception_ptr error;
+		try {
+			// First row of the block inside [begin, end) that belongs to this worker
+			const glm::u32 rank = mSlots[worker].rank;
+			for (glm::u32 y = start + (rank + node.workerCount - (start - first) % node.workerCount) % node.workerCount; y < last; y += node.workerCount) {
+				(*job)(y);
+			}
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		{
+			std::scoped_lock lock(mMutex);
+			if (error && !mError) {
+				mError = error;
+			}
+			if (--mPending == 0) {
+				mDone.notify_one();
+			}
+		}
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads pinned one per CPU (on Linux) that split rows the same way every frame. Each NUMA node gets
+// one contiguous block of rows, sized by its share of the workers and starting on a page boundary, and
+// interleaves that block between its own workers. Pages faulted in through Run() therefore stay on the node
+// that traces them, and so does every later frame that accumulates into them. Without a readable topology
+// all workers count as one node.
+class RowPool {
+public:
+    RowPool();
+    ~RowPool();
+
+    RowPool(const RowPool&) = delete;
+    RowPool& operator=(const RowPool&) = delete;
+
+    // Calls `perRow` for every row in [begin, end) and returns once all rows are done. Rows are assigned
+    // as if the whole buffer of `rows` rows was being traced, node blocks start on multiples of
+    // `rowsPerPage`, so the same row always lands on the same worker no matter which range is run. Calls
+    // from different threads run one after another. If `perRow` throws, the remaining rows of that worker
+    // are skipped and the first exception is rethrown here.
+    void Run(const glm::u32 begin, const glm::u32 end, const glm::u32 rows, const glm::u32 rowsPerPage,
+        const std::function<void(glm::u32)>& perRow);
+
+    [[nodiscard]] glm::u32 GetSize() const { return mSize; }
+    [[nodiscard]] glm::u32 GetNodeCount() const { return static_cast<glm::u32>(mNodes.size()); }
+
+private:
+    struct Node {
+        glm::u32 firstWorker;
+        glm::u32 workerCount;
+    };
+
+    struct Slot {
+        glm::u32 node;
+        glm::u32 rank;
+    };
+
+    void WorkerLoop(const glm::u32 worker);
+
+private:
+    std::mutex mRunMutex;
+
+    std::mutex mMutex;
+    std::condition_variable mWakeup;
+    std::condition_variable mDone;
+    const std::function<void(glm::u32)>* mJob;
+    glm::u32 mBegin, mEnd;
+    glm::u32 mRows, mRowsPerPage;
+    std::uint64_t mGeneration;
+    glm::u32 mPending;
+    bool mStopping;
+    std::exception_ptr mError;
+
+    glm::u32 mSize;
+    std::vector<Node> mNodes;
+    std::vector<Slot> mSlots;
+    std::vector<std::thread> mWorkers;
+};
@@ -2,6 +2,7 @@
 
 #include "glm/glm.hpp"
 
+#include <string>
 #include <vector>
 
 struct Material {
@@ -10,6 +11,12 @@ struct Material {
     glm::f32 metallic;
     glm::vec3 emissiveColor;
     glm::f32 emissiveStrength;
+
+    // Indices into Scene::textures, -1 if the channel is untextured. Maps modulate the constants above.
+    int albedoTexture = -1;
+    int roughnessTexture = -1;
+    int metallicTexture = -1;
+    int emissiveTexture = -1;
 };
 
 struct Sphere {
@@ -21,4 +28,5 @@ struct Sphere {
 struct Scene {
     std::vector<Sphere> spheres;
     std::vector<Material> materials;
+    std::vector<std::string> textures;
 };
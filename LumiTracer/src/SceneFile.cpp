@@ -0,0 +1,91 @@
+#include "SceneFile.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace {
+	static std::string restOfLine(std::istringstream& stream) {
+		std::string rest;
+		std::getline(stream >> std::ws, rest);
+		return rest;
+	}
+
+	// Relative paths are relative to the scene file, not the working directory of whoever loads it
+	static std::string resolvePath(const std::filesystem::path& directory, const std::string& path) {
+		const std::filesystem::path resolved(path);
+		return path.empty() || resolved.is_absolute() ? path : (directory / resolved).lexically_normal().string();
+	}
+}
+
+bool LoadSceneFile(const std::string& path, SceneFile& file, std::string& error) {
+	std::ifstream in(path);
+	if (!in) {
+		error = "cannot open " + path;
+		return false;
+	}
+
+	file = SceneFile();
+
+	const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+	std::string line;
+	for (int lineNumber = 1; std::getline(in, line); lineNumber++) {
+		std::istringstream stream(line);
+
+		std::string keyword;
+		if (!(stream >> keyword) || keyword[0] == '#') {
+			continue;
+		}
+
+		if (keyword == "texture") {
+			file.scene.textures.push_back(resolvePath(directory, restOfLine(stream)));
+		} else if (keyword == "geometry") {
+			file.geometryPath = resolvePath(directory, restOfLine(stream));
+		} else if (keyword == "material") {
+			Material material = {};
+			stream >> material.albedo.r >> material.albedo.g >> material.albedo.b
+				   >> material.roughness >> material.metallic
+				   >> material.emissiveColor.r >> material.emissiveColor.g >> material.emissiveColor.b
+				   >> material.emissiveStrength;
+
+			if (!stream) {
+				error = path + ":" + std::to_string(lineNumber) + ": malformed material";
+				return false;
+			}
+
+			// Texture maps are optional
+			int maps[4];
+			if (stream >> maps[0] >> maps[1] >> maps[2] >> maps[3]) {
+				material.albedoTexture = maps[0];
+				material.roughnessTexture = maps[1];
+				material.metallicTexture = maps[2];
+				material.emissiveTexture = maps[3];
+			}
+
+			file.scene.materials.push_back(material);
+		} else if (keyword == "sphere") {
+			Sphere sphere;
+			stream >> sphere.position.x >> sphere.position.y >> sphere.position.z >> sphere.radius >> sphere.materialIndex;
+
+			if (!stream) {
+				error = path + ":" + std::to_string(lineNumber) + ": malformed sphere";
+				return false;
+			}
+
+			file.scene.spheres.push_back(sphere);
+		} else {
+			error = path + ":" + std::to_string(lineNumber) + ": unknown entry '" + keyword + "'";
+			return false;
+		}
+	}
+
+	for (const Sphere& sphere : file.scene.spheres) {
+		if (sphere.materialIndex < 0 || sphere.materialIndex >= static_cast<int>(file.scene.materials.size())) {
+			error = path + ": sphere references missing material " + std::to_string(sphere.materialIndex);
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+#include "Scene.h"
+
+// Plain text scene description, one entry per line:
+//
+//   texture <path>
+//   material <r g b> <roughness> <metallic> <emissive r g b> <emissive strength> [<albedo map> <roughness map> <metallic map> <emissive map>]
+//   sphere <x y z> <radius> <material>
+//   geometry <path to .luxgeo>
+//
+// Lines starting with '#' are comments. Relative texture and geometry paths are resolved against the
+// directory of the scene file.
+struct SceneFile {
+    Scene scene;
+    std::string geometryPath;
+};
+
+bool LoadSceneFile(const std::string& path, SceneFile& file, std::string& error);
@@ -0,0 +1,410 @@
+#include "Texture.h"
+
+// Walnut already compiles stb_image, headless builds have to provide it themselves
+#ifdef LUX_HEADLESS
+#define STB_IMAGE_IMPLEMENTATION
+#endif
+#include "stb_image.h"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace {
+	constexpr glm::u32 FileMagic = 0x5458554C; // "LUXT"
+	constexpr glm::u32 FileVersion = 1;
+
+	struct FileHeader {
+		glm::u32 magic;
+		glm::u32 version;
+		glm::u32 width;
+		glm::u32 height;
+		glm::u32 levelCount;
+		glm::u32 tileSize;
+	};
+
+	constexpr std::size_t TileBytes = TextureCache::TileSize * TextureCache::TileSize * sizeof(glm::u32);
+
+	static glm::vec4 unpackRGBA(const glm::u32 texel) {
+		return glm::vec4(
+			static_cast<glm::f32>((texel >> 0) & 0xFF),
+			static_cast<glm::f32>((texel >> 8) & 0xFF),
+			static_cast<glm::f32>((texel >> 16) & 0xFF),
+			static_cast<glm::f32>((texel >> 24) & 0xFF)
+		) / 255.0f;
+	}
+
+	static glm::u32 tilesFor(const glm::u32 extent) {
+		return (extent + TextureCache::TileSize - 1) / TextureCache::TileSize;
+	}
+
+	static glm::u32 levelCountFor(glm::u32 width, glm::u32 height) {
+		glm::u32 count = 1;
+		while (width > 1 || height > 1) {
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+			count++;
+		}
+		return count;
+	}
+
+	static std::uint64_t tileKey(const glm::u32 texture, const glm::u32 level, const glm::u32 tileX, const glm::u32 tileY) {
+		return (static_cast<std::uint64_t>(texture) << 48) | (static_cast<std::uint64_t>(level) << 40) | (static_cast<std::uint64_t>(tileY) << 20) | tileX;
+	}
+
+	// Writes one level as a row-major grid of tiles, padding partial edge tiles by clamping.
+	static void writeTiles(std::ofstream& out, const std::vector<glm::u32>& texels, const glm::u32 width, const glm::u32 height) {
+		std::vector<glm::u32> tile(TextureCache::TileSize * TextureCache::TileSize);
+
+		for (glm::u32 ty = 0; ty < tilesFor(height); ty++) {
+			for (glm::u32 tx = 0; tx < tilesFor(width); tx++) {
+				for (glm::u32 y = 0; y < TextureCache::TileSize; y++) {
+					const glm::u32 srcY = std::min(ty * TextureCache::TileSize + y, height - 1);
+					for (glm::u32 x = 0; x < TextureCache::TileSize; x++) {
+						const glm::u32 srcX = std::min(tx * TextureCache::TileSize + x, width - 1);
+						tile[x + y * TextureCache::TileSize] = texels[srcX + srcY * width];
+					}
+				}
+
+				out.write(reinterpret_cast<const char*>(tile.data()), TileBytes);
+			}
+		}
+	}
+
+	static std::vector<glm::u32> downsample(const std::vector<glm::u32>& texels, const glm::u32 width, const glm::u32 height) {
+		const glm::u32 nextWidth = std::max(width / 2, 1u);
+		const glm::u32 nextHeight = std::max(height / 2, 1u);
+
+		std::vector<glm::u32> next(nextWidth * nextHeight);
+		for (glm::u32 y = 0; y < nextHeight; y++) {
+			for (glm::u32 x = 0; x < nextWidth; x++) {
+				const glm::u32 x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+				const glm::u32 y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+
+				glm::u32 result = 0;
+				for (glm::u32 shift = 0; shift < 32; shift += 8) {
+					const glm::u32 sum = ((texels[x0 + y0 * width] >> shift) & 0xFF) + ((texels[x1 + y0 * width] >> shift) & 0xFF)
+									   + ((texels[x0 + y1 * width] >> shift) & 0xFF) + ((texels[x1 + y1 * width] >> shift) & 0xFF);
+					result |= ((sum + 2) / 4) << shift;
+				}
+				next[x + y * nextWidth] = result;
+			}
+		}
+
+		return next;
+	}
+
+	static std::string temporaryPath(const std::string& destination) {
+		static std::atomic<std::uint64_t> counter = 0;
+		std::random_device random;
+
+		std::ostringstream path;
+		path << destination << "." << std::hex << random() << "-" << std::hash<std::thread::id>{}(std::this_thread::get_id()) << "-" << counter++ << ".tmp";
+		return path.str();
+	}
+}
+
+TextureCache::TextureCache(const std::size_t budgetBytes)
+	: mTextures()
+	, mShards()
+	, mBudget(budgetBytes)
+	, mResidentBytes(0)
+	, mCacheDirectory()
+{ }
+
+void TextureCache::SetCacheDirectory(const std::string& directory) {
+	if (directory == mCacheDirectory) {
+		return;
+	}
+
+	mCacheDirectory = directory;
+	this->Clear();
+}
+
+void TextureCache::Sync(const std::vector<std::string>& paths) {
+	bool changed = paths.size() < mTextures.size();
+	for (std::size_t i = 0; i < mTextures.size() && !changed; i++) {
+		changed = mTextures[i]->path != paths[i];
+	}
+
+	if (changed) {
+		this->Clear();
+	}
+
+	for (std::size_t i = mTextures.size(); i < paths.size(); i++) {
+		auto texture = std::make_unique<Texture>();
+		texture->path = paths[i];
+		texture->valid = Open(*texture);
+
+		if (!texture->valid) {
+			std::cerr << "Failed to load texture " << paths[i] << std::endl;
+		}
+
+		mTextures.push_back(std::move(texture));
+	}
+}
+
+glm::vec4 TextureCache::Sample(const glm::u32 texture, const glm::vec2 uv, const glm::f32 footprint) {
+	if (texture >= mTextures.size() || !mTextures[texture]->valid) [[unlikely]] {
+		return glm::vec4(1.0f, 0.0f, 1.0f, 1.0f);
+	}
+
+	const std::vector<Level>& levels = mTextures[texture]->levels;
+	const glm::f32 extent = static_cast<glm::f32>(std::max(levels[0].width, levels[0].height));
+	const glm::f32 lod = glm::clamp(glm::log2(std::max(footprint * extent, 1.0f)), 0.0f, static_cast<glm::f32>(levels.size() - 1));
+
+	const glm::u32 level = static_cast<glm::u32>(lod);
+	const glm::f32 blend = lod - static_cast<glm::f32>(level);
+
+	glm::vec4 color = this->SampleBilinear(texture, level, uv);
+	if (blend > 0.0f && level + 1 < levels.size()) {
+		color = glm::mix(color, this->SampleBilinear(texture, level + 1, uv), blend);
+	}
+
+	return color;
+}
+
+glm::vec4 TextureCache::SampleBilinear(const glm::u32 texture, const glm::u32 level, const glm::vec2 uv) {
+	const Level& info = mTextures[texture]->levels[level];
+
+	const glm::f32 fx = uv.x * static_cast<glm::f32>(info.width) - 0.5f;
+	const glm::f32 fy = uv.y * static_cast<glm::f32>(info.height) - 0.5f;
+	const glm::f32 x0 = glm::floor(fx), y0 = glm::floor(fy);
+	const glm::f32 tx = fx - x0, ty = fy - y0;
+
+	// The four taps usually share a tile, so hold on to the last one instead of going through the cache each time.
+	TileRef tile;
+	glm::u32 tileX = 0, tileY = 0;
+
+	auto fetch = [&](const glm::f32 px, const glm::f32 py) -> glm::vec4 {
+		const glm::i32 w = static_cast<glm::i32>(info.width), h = static_cast<glm::i32>(info.height);
+		const glm::u32 x = static_cast<glm::u32>(((static_cast<glm::i32>(px) % w) + w) % w);
+		const glm::u32 y = static_cast<glm::u32>(((static_cast<glm::i32>(py) % h) + h) % h);
+
+		if (!tile || x / TileSize != tileX || y / TileSize != tileY) {
+			tileX = x / TileSize;
+			tileY = y / TileSize;
+			tile = this->AcquireTile(texture, level, tileX, tileY);
+		}
+
+		if (!tile) [[unlikely]] {
+			return glm::vec4(1.0f, 0.0f, 1.0f, 1.0f);
+		}
+
+		return unpackRGBA(tile->texels[(x % TileSize) + (y % TileSize) * TileSize]);
+	};
+
+	const glm::vec4 top = glm::mix(fetch(x0, y0), fetch(x0 + 1.0f, y0), tx);
+	const glm::vec4 bottom = glm::mix(fetch(x0, y0 + 1.0f), fetch(x0 + 1.0f, y0 + 1.0f), tx);
+
+	return glm::mix(top, bottom, ty);
+}
+
+TextureCache::TileRef TextureCache::AcquireTile(const glm::u32 texture, const glm::u32 level, const glm::u32 tileX, const glm::u32 tileY) {
+	const std::uint64_t key = tileKey(texture, level, tileX, tileY);
+	Shard& shard = mShards[(key * 0x9E3779B97F4A7C15ull) >> 60];
+
+	{
+		std::scoped_lock lock(shard.mutex);
+
+		const auto it = shard.lookup.find(key);
+		if (it != shard.lookup.end()) {
+			shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+			return *it->second;
+		}
+	}
+
+	// Read outside of the shard lock so a miss doesn't stall hits on unrelated tiles.
+	TileRef tile = this->LoadTile(texture, level, tileX, tileY);
+	if (!tile) {
+		return nullptr;
+	}
+
+	std::scoped_lock lock(shard.mutex);
+
+	const auto it = shard.lookup.find(key);
+	if (it != shard.lookup.end()) {
+		return *it->second;
+	}
+
+	shard.lru.push_front(tile);
+	shard.lookup[key] = shard.lru.begin();
+	shard.residentBytes += TileBytes;
+	mResidentBytes += TileBytes;
+
+	this->Trim(shard, 1);
+
+	return tile;
+}
+
+void TextureCache::SetBudget(const std::size_t bytes) {
+	const std::size_t previous = mBudget.exchange(bytes);
+	if (bytes >= previous) {
+		return;
+	}
+
+	// Shards only trim themselves on a miss, which might not come for a long time
+	for (Shard& shard : mShards) {
+		std::scoped_lock lock(shard.mutex);
+		this->Trim(shard, 0);
+	}
+}
+
+void TextureCache::Trim(Shard& shard, const std::size_t keepTiles) {
+	const std::size_t shardBudget = mBudget / ShardCount;
+	while (shard.residentBytes > shardBudget && shard.lru.size() > keepTiles) {
+		shard.lookup.erase(shard.lru.back()->key);
+		shard.lru.pop_back();
+		shard.residentBytes -= TileBytes;
+		mResidentBytes -= TileBytes;
+	}
+}
+
+TextureCache::TileRef TextureCache::LoadTile(const glm::u32 index, const glm::u32 level, const glm::u32 tileX, const glm::u32 tileY) {
+	Texture& texture = *mTextures[index];
+	const Level& info = texture.levels[level];
+
+	auto tile = std::make_shared<Tile>();
+	tile->key = tileKey(index, level, tileX, tileY);
+	tile->texels.resize(TileSize * TileSize);
+
+	std::scoped_lock lock(texture.fileMutex);
+
+	texture.file.seekg(info.fileOffset + (tileX + tileY * info.tilesX) * TileBytes);
+	texture.file.read(reinterpret_cast<char*>(tile->texels.data()), TileBytes);
+
+	if (!texture.file) {
+		texture.file.clear();
+		return nullptr;
+	}
+
+	return tile;
+}
+
+bool TextureCache::Open(Texture& texture) const {
+	const std::filesystem::path source = texture.path;
+	std::filesystem::path tiled = texture.path + ".luxtex";
+
+	std::error_code error;
+	if (!mCacheDirectory.empty()) {
+		// Textures from different directories may share a file name, the hash of the full path tells them apart
+		const std::string absolute = std::filesystem::absolute(source, error).lexically_normal().string();
+		std::ostringstream name;
+		name << std::hex << std::hash<std::string>{}(absolute) << "-" << source.filename().string() << ".luxtex";
+
+		std::filesystem::create_directories(mCacheDirectory, error);
+		tiled = std::filesystem::path(mCacheDirectory) / name.str();
+	}
+
+	const bool sourceExists = std::filesystem::exists(source, error);
+	const bool tiledExists = std::filesystem::exists(tiled, error);
+
+	if (!tiledExists || (sourceExists && std::filesystem::last_write_time(tiled, error) < std::filesystem::last_write_time(source, error))) {
+		if (!sourceExists || !Convert(source.string(), tiled.string())) {
+			return false;
+		}
+	}
+
+	texture.file.open(tiled, std::ios::binary);
+
+	FileHeader header;
+	texture.file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	if (!texture.file || header.magic != FileMagic || header.version != FileVersion || header.tileSize != TileSize || header.width == 0 || header.height == 0) {
+		return false;
+	}
+
+	std::uint64_t offset = sizeof(FileHeader);
+	glm::u32 width = header.width, height = header.height;
+
+	for (glm::u32 i = 0; i < header.levelCount; i++) {
+		const Level level = {
+			.width = width,
+			.height = height,
+			.tilesX = tilesFor(width),
+			.tilesY = tilesFor(height),
+			.fileOffset = offset
+		};
+
+		texture.levels.push_back(level);
+
+		offset += static_cast<std::uint64_t>(level.tilesX) * level.tilesY * TileBytes;
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+
+	return true;
+}
+
+bool TextureCache::Convert(const std::string& source, const std::string& destination) {
+	int width, height, channels;
+	stbi_uc* pixels = stbi_load(source.c_str(), &width, &height, &channels, 4);
+
+	if (!pixels) {
+		return false;
+	}
+
+	std::vector<glm::u32> texels(static_cast<std::size_t>(width) * height);
+	std::memcpy(texels.data(), pixels, texels.size() * sizeof(glm::u32));
+	stbi_image_free(pixels);
+
+	// Every writer gets its own temporary file, so concurrent conversions of the same texture, from this
+	// process or another, can't interleave. They all produce the same file, whichever rename lands last wins.
+	const std::string temporary = temporaryPath(destination);
+	std::error_code error;
+
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+
+		glm::u32 levelWidth = static_cast<glm::u32>(width), levelHeight = static_cast<glm::u32>(height);
+
+		const FileHeader header = {
+			.magic = FileMagic,
+			.version = FileVersion,
+			.width = levelWidth,
+			.height = levelHeight,
+			.levelCount = levelCountFor(levelWidth, levelHeight),
+			.tileSize = TileSize
+		};
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		// Only one level is kept in memory at a time.
+		for (glm::u32 i = 0; i < header.levelCount; i++) {
+			writeTiles(out, texels, levelWidth, levelHeight);
+
+			texels = downsample(texels, levelWidth, levelHeight);
+			levelWidth = std::max(levelWidth / 2, 1u);
+			levelHeight = std::max(levelHeight / 2, 1u);
+		}
+
+		if (!out) {
+			out.close();
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(temporary, destination, error);
+	if (error) {
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+
+	return true;
+}
+
+void TextureCache::Clear() {
+	for (Shard& shard : mShards) {
+		std::scoped_lock lock(shard.mutex);
+		shard.lru.clear();
+		shard.lookup.clear();
+		shard.residentBytes = 0;
+	}
+
+	mTextures.clear();
+	mResidentBytes = 0;
+}
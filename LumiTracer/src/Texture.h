@@ -0,0 +1,92 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Streams material maps in fixed size tiles from a mipmapped on-disk copy (<path>.luxtex, or a file in the
+// cache directory) so that only the tiles rays actually touch are resident. Tiles are evicted in LRU order
+// once the budget is exceeded.
+class TextureCache {
+public:
+    static constexpr glm::u32 TileSize = 64;
+
+    explicit TextureCache(const std::size_t budgetBytes = 512ull << 20);
+
+    // Registers the scene's texture paths. Indices match Scene::textures.
+    void Sync(const std::vector<std::string>& paths);
+
+    // Trilinearly filtered lookup with repeat addressing. `footprint` is the width of the
+    // sampled area in uv units and selects the mip level.
+    [[nodiscard]] glm::vec4 Sample(const glm::u32 texture, const glm::vec2 uv, const glm::f32 footprint);
+
+    // Where tiled copies are written, e.g. when textures live on a read-only share. Empty puts them next to
+    // their source image. Changing it reopens every texture on the next Sync().
+    void SetCacheDirectory(const std::string& directory);
+    [[nodiscard]] const std::string& GetCacheDirectory() const { return mCacheDirectory; }
+
+    // Lowering the budget evicts from every shard right away.
+    void SetBudget(const std::size_t bytes);
+    [[nodiscard]] std::size_t GetBudget() const { return mBudget; }
+    [[nodiscard]] std::size_t GetResidentBytes() const { return mResidentBytes; }
+
+private:
+    struct Level {
+        glm::u32 width, height;
+        glm::u32 tilesX, tilesY;
+        std::uint64_t fileOffset;
+    };
+
+    struct Texture {
+        std::string path;
+        std::vector<Level> levels;
+        std::ifstream file;
+        std::mutex fileMutex;
+        bool valid = false;
+    };
+
+    struct Tile {
+        std::uint64_t key;
+        std::vector<glm::u32> texels;
+    };
+
+    using TileRef = std::shared_ptr<const Tile>;
+
+    // Each shard owns its own lock and LRU list so render threads rarely wait on each other.
+    struct Shard {
+        std::mutex mutex;
+        std::list<TileRef> lru;
+        std::unordered_map<std::uint64_t, std::list<TileRef>::iterator> lookup;
+        std::size_t residentBytes = 0;
+    };
+
+    static constexpr glm::u32 ShardCount = 16;
+
+    bool Open(Texture& texture) const;
+    static bool Convert(const std::string& source, const std::string& destination);
+
+    TileRef AcquireTile(const glm::u32 texture, const glm::u32 level, const glm::u32 tileX, const glm::u32 tileY);
+    TileRef LoadTile(const glm::u32 texture, const glm::u32 level, const glm::u32 tileX, const glm::u32 tileY);
+
+    // Drops least recently used tiles until the shard fits its share of the budget. Requires the shard lock.
+    void Trim(Shard& shard, const std::size_t keepTiles);
+
+    glm::vec4 SampleBilinear(const glm::u32 texture, const glm::u32 level, const glm::vec2 uv);
+
+    void Clear();
+
+private:
+    std::vector<std::unique_ptr<Texture>> mTextures;
+    std::array<Shard, ShardCount> mShards;
+    std::atomic<std::size_t> mBudget;
+    std::atomic<std::size_t> mResidentBytes;
+    std::string mCacheDirectory;
+};
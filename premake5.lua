@@ -8,3 +8,10 @@ outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
 include "Walnut/WalnutExternal.lua"
 
 include "LumiTracer"
+include "LumiCAPI"
+
+-- The render server talks over Unix domain sockets
+if not os.istarget("windows") then
+   include "LumiServer"
+   include "LumiClient"
+end